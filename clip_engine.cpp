@@ -1,89 +1,121 @@
 #include <algorithm>
 #include "clip_engine.h"
 
-std::vector<Vertex> ClipEngine::clipVertexes(const std::vector<Vertex> &vertexes) const {
-    std::vector<Vertex> input, output = vertexes;
-    const size_t projections[] = {3, 5, 6}; // (0,1,1), (1,0,1), (1,1,0)
-    
-    for (const auto& projection : projections) {
-        std::vector<size_t> axises;
-        
+const size_t clippingPlaneCount = 6;
+
+const size_t ClipPolygon::capacity;
+
+ClipEngine::ClipEngine() {
+    guardBandScale = 8;
+}
+
+Real ClipEngine::getGuardBandScale() const {
+    return guardBandScale;
+}
+
+void ClipEngine::setGuardBandScale(Real guardBandScale) {
+    this->guardBandScale = std::max(guardBandScale, Real(1));
+}
+
+void ClipEngine::clipTriangle(const Vertex &a, const Vertex &b, const Vertex &c, ClipPolygon &polygon) const {
+    unsigned crossedPlanes = 0;
+
+    polygon.vertexes[0] = a;
+    polygon.vertexes[1] = b;
+    polygon.vertexes[2] = c;
+    polygon.vertexCount = 3;
+
+    // Planes which every vertex is inside of are skipped
+    for (size_t plane = 0; plane < clippingPlaneCount; ++plane) {
         for (size_t i = 0; i < 3; ++i) {
-            if (((1 << i) & projection) != 0) {
-                axises.push_back(i);
+            if (!(getPlaneDistance(polygon.vertexes[i].position, plane) >= 0)) {
+                crossedPlanes |= 1u << plane;
             }
         }
+    }
 
-        input = output;
-        output.clear();
+    if (crossedPlanes == 0) {
+        return;
+    }
 
-        for (size_t i = 2; i < input.size(); i = i + 3) {
-            bool isFullyInside = true;
+    // Each clipped plane writes the polygon to the other buffer
+    ClipPolygon clippedPolygon;
+    ClipPolygon *input = &polygon;
+    ClipPolygon *output = &clippedPolygon;
 
-            for (size_t j = 0; j < 3; ++j) {
-                isFullyInside = isFullyInside && isInsideClippingSquare(input[(i-2) + j].position, axises);
-            }
+    for (size_t plane = 0; plane < clippingPlaneCount && input->vertexCount >= 3; ++plane) {
+        if ((crossedPlanes & (1u << plane)) != 0) {
+            clipSutherlandHodgman(*input, plane, *output);
+            std::swap(input, output);
+        }
+    }
 
-            if (isFullyInside) {
-                for (size_t j = 0; j < 3; ++j) {
-                    output.push_back(input[(i-2) + j]);
-                }
-                continue;
-            }
+    if (input->vertexCount < 3) {
+        polygon.vertexCount = 0;
+    } else if (input != &polygon) {
+        std::copy(input->vertexes, input->vertexes + input->vertexCount, polygon.vertexes);
+        polygon.vertexCount = input->vertexCount;
+    }
+}
 
-            auto clippedPolygon = clipSutherlandHodgman({input[i-2].position, input[i-1].position, input[i].position}, axises);
+void ClipEngine::clipVertexes(const std::vector<Vertex> &vertexes, std::vector<Vertex> &output) const {
+    ClipPolygon polygon;
 
-            // TODO Triangulate clippedPolygon and push vertexes to output
+    for (size_t i = 2; i < vertexes.size(); i = i + 3) {
+        clipTriangle(vertexes[i-2], vertexes[i-1], vertexes[i], polygon);
+
+        for (size_t j = 2; j < polygon.vertexCount; ++j) {
+            output.push_back(polygon.vertexes[0]);
+            output.push_back(polygon.vertexes[j-1]);
+            output.push_back(polygon.vertexes[j]);
         }
     }
-
-    return output;
 }
 
-bool ClipEngine::isInsideClippingSquare(Vector4 vertex, const std::vector<size_t> &axises) const {
-    double w = vertex.w();
-    return vertex[axises[0]] > w && vertex[axises[0]] < -w && vertex[axises[1]] > w && vertex[axises[1]] < -w;
+Real ClipEngine::getPlaneDistance(const Vector4 &position, size_t plane) const {
+    const size_t axis = plane / 2;
+    const Real w = axis < 2 ? position.cw() * guardBandScale : position.cw();
+
+    return plane % 2 == 0 ? position.c(axis) - w : -w - position.c(axis);
 }
 
-Vector4 ClipEngine::getIntersection(Vector4 vertexA, Vector4 vertexB, Vector4 planeA, Vector4 planeB, const std::vector<size_t> &axises) const {
-    Vector4 intersection;
+void ClipEngine::setIntersection(const Vertex &vertexA, const Vertex &vertexB, Real distanceA, Real distanceB, Vertex &intersection) const {
+    const Real t = distanceA / (distanceA - distanceB);
 
-    // TODO How to calculate intersection when vertexA.w() != vertexB.w() ?
+    for (size_t j = 0; j < 4; ++j) {
+        intersection.origin[j] = vertexA.origin.c(j) + t * (vertexB.origin.c(j) - vertexA.origin.c(j));
+        intersection.position[j] = vertexA.position.c(j) + t * (vertexB.position.c(j) - vertexA.position.c(j));
+        intersection.color[j] = vertexA.color.c(j) + t * (vertexB.color.c(j) - vertexA.color.c(j));
+        intersection.normal[j] = vertexA.normal.c(j) + t * (vertexB.normal.c(j) - vertexA.normal.c(j));
+    }
 
-    return intersection;
+    intersection.index = SIZE_MAX;
 }
 
-std::vector<Vector4> ClipEngine::clipSutherlandHodgman(const std::vector<Vector4> &polygon, const std::vector<size_t> &axises) const {
-    std::vector<Vector4> input, output = polygon;
-    const size_t planes[] = {0, 1, 3, 2}; // 00, 01, 11, 10
-
-    for (size_t i = 0; i < 4; ++i) {
-        Vector4 pa, pb;
-        pa[axises[0]] = planes[i] & 1;
-        pa[axises[1]] = planes[i] & 2;
-        pb[axises[0]] = planes[(i+1) % 4] & 1;
-        pb[axises[1]] = planes[(i+1) % 4] & 2;
-
-        input = output;
-        output.clear();
-
-        for (size_t i = 0; i < polygon.size(); ++i) {
-            auto& va = polygon[i];
-            auto& vb = polygon[(i+1) % polygon.size()];
-
-            // TODO Replace isInsideClippingSquare with line-plane orientation checking function ?
-            if (isInsideClippingSquare(va, axises)) {
-                if (isInsideClippingSquare(vb, axises)) {
-                    output.push_back(vb);
-                } else {
-                    output.push_back(getIntersection(va, vb, pa, pb, axises));
-                }
-            } else if (isInsideClippingSquare(vb, axises)) {
-                output.push_back(getIntersection(va, vb, pa, pb, axises));
-                output.push_back(vb);
-            }
-        }
+void ClipEngine::clipSutherlandHodgman(const ClipPolygon &polygon, size_t plane, ClipPolygon &clippedPolygon) const {
+    Real distances[ClipPolygon::capacity];
+
+    for (size_t i = 0; i < polygon.vertexCount; ++i) {
+        distances[i] = getPlaneDistance(polygon.vertexes[i].position, plane);
     }
 
-    return output;
+    clippedPolygon.vertexCount = 0;
+
+    // Positions on the plane count as inside, so that vertexes created by one plane are not clipped again.
+    // Edges which only touch the plane get no intersection, which would repeat their end on the plane.
+    // A convex polygon crosses the plane at most twice and gains at most one vertex, vertexes which rounding
+    // would add beyond the capacity are dropped.
+    for (size_t i = 0; i < polygon.vertexCount && clippedPolygon.vertexCount < ClipPolygon::capacity; ++i) {
+        const size_t j = (i + 1) % polygon.vertexCount;
+        const bool isIntersected = (distances[i] > 0 && distances[j] < 0) || (distances[i] < 0 && distances[j] > 0);
+
+        if (isIntersected) {
+            setIntersection(polygon.vertexes[i], polygon.vertexes[j], distances[i], distances[j],
+                clippedPolygon.vertexes[clippedPolygon.vertexCount++]);
+        }
+
+        if (distances[j] >= 0 && clippedPolygon.vertexCount < ClipPolygon::capacity) {
+            clippedPolygon.vertexes[clippedPolygon.vertexCount++] = polygon.vertexes[j];
+        }
+    }
 }
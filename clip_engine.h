@@ -4,19 +4,46 @@
 #include <vector>
 #include "vertex.h"
 
+// Visible part of a clipped triangle, a triangle clipped by six planes gains at most one vertex per plane
+struct ClipPolygon {
+    static const size_t capacity = 9;
+    Vertex vertexes[capacity];
+    size_t vertexCount = 0;
+};
+
+// Clips triangles in clip space, where visible positions satisfy w < x, y, z < -w. Triangles are clipped against
+// the near and far planes and against the guard band, which is the view volume widened along x and y. Parts of
+// triangles outside of the view but inside of the guard band are left to the rasterizer, which skips them anyway.
+// Clipping works on polygons kept on the stack, so it does not allocate memory.
 class ClipEngine {
 
 public:
 
-    std::vector<Vertex> clipVertexes(const std::vector<Vertex> &vertexes) const;
+    ClipEngine();
+
+    // The guard band spans w * scale < x, y < -w * scale
+    Real getGuardBandScale() const;
+    void setGuardBandScale(Real guardBandScale);
+
+    // The polygon keeps the winding of the triangle, attributes of new vertexes are interpolated linearly in clip space
+    void clipTriangle(const Vertex &a, const Vertex &b, const Vertex &c, ClipPolygon &polygon) const;
+
+    // Every 3 consecutive vertexes form a triangle, the visible part of each one is appended to output as a fan
+    // of triangles. An output vector cleared and reused between calls stops allocating once it is large enough.
+    void clipVertexes(const std::vector<Vertex> &vertexes, std::vector<Vertex> &output) const;
 
 private:
 
-    bool isInsideClippingSquare(Vector4 vertex, const std::vector<size_t> &axises) const;
-    Vector4 getIntersection(Vector4 vertexA, Vector4 vertexB, Vector4 planeA, Vector4 planeB, const std::vector<size_t> &axises) const;
+    // Positive inside of the plane, planes are the guard band along x and y followed by the near and far planes
+    Real getPlaneDistance(const Vector4 &position, size_t plane) const;
+    void setIntersection(const Vertex &vertexA, const Vertex &vertexB, Real distanceA, Real distanceB, Vertex &intersection) const;
+
+    void clipSutherlandHodgman(const ClipPolygon &polygon, size_t plane, ClipPolygon &clippedPolygon) const;
+
+private:
 
-    std::vector<Vector4> clipSutherlandHodgman(const std::vector<Vector4> &polygon, const std::vector<size_t> &axises) const;
+    Real guardBandScale;
 
 };
 
-#endif
\ No newline at end of file
+#endif
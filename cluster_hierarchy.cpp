@@ -0,0 +1,208 @@
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include "cluster_hierarchy.h"
+
+// Boxes are tested with a margin covering the rounding of the transform, so that a cluster is culled only if
+// the clipping test of every one of its triangles would reject it as well
+const Real planeMarginScale = 64 * std::numeric_limits<Real>::epsilon();
+
+const size_t ClusterHierarchy::clusterTriangleCount;
+
+ClusterHierarchy::ClusterHierarchy() {
+}
+
+void ClusterHierarchy::build(const Mesh &mesh) {
+    const size_t triangleCount = mesh.getTriangleCount();
+    const size_t clusterCount = (triangleCount + clusterTriangleCount - 1) / clusterTriangleCount;
+    const Vector4 *positions = mesh.getPositions();
+    const size_t *indexes = mesh.getIndexes();
+
+    clear();
+    clusterBoxes.resize(6 * clusterCount);
+    clusterVertexRanges.resize(2 * clusterCount);
+    clusterOrder.resize(clusterCount);
+
+    for (size_t cluster = 0; cluster < clusterCount; ++cluster) {
+        Real *box = &clusterBoxes[6 * cluster];
+        size_t first = SIZE_MAX, last = 0;
+        bool isBounded = true;
+
+        std::fill(box, box + 3, std::numeric_limits<Real>::infinity());
+        std::fill(box + 3, box + 6, -std::numeric_limits<Real>::infinity());
+
+        for (size_t i = 3 * cluster * clusterTriangleCount; i < 3 * std::min((cluster + 1) * clusterTriangleCount, triangleCount); ++i) {
+            const Vector4 &position = positions[indexes[i]];
+
+            first = std::min(first, indexes[i]);
+            last = std::max(last, indexes[i] + 1);
+
+            for (size_t j = 0; j < 3; ++j) {
+                isBounded = isBounded && std::isfinite(position.c(j));
+                box[j] = std::min(box[j], position.c(j));
+                box[3 + j] = std::max(box[3 + j], position.c(j));
+            }
+        }
+
+        // Clusters with non finite coordinates are never culled
+        if (!isBounded) {
+            std::fill(box, box + 3, -std::numeric_limits<Real>::infinity());
+            std::fill(box + 3, box + 6, std::numeric_limits<Real>::infinity());
+        }
+
+        clusterVertexRanges[2 * cluster] = first;
+        clusterVertexRanges[2 * cluster + 1] = last;
+        clusterOrder[cluster] = cluster;
+    }
+
+    if (clusterCount > 0) {
+        nodes.reserve(2 * clusterCount - 1);
+        buildNode(0, clusterCount);
+    }
+}
+
+void ClusterHierarchy::clear() {
+    clusterBoxes.clear();
+    clusterVertexRanges.clear();
+    clusterOrder.clear();
+    nodes.clear();
+}
+
+size_t ClusterHierarchy::getClusterCount() const {
+    return clusterOrder.size();
+}
+
+void ClusterHierarchy::getClusterVertexRange(size_t cluster, size_t &first, size_t &last) const {
+    first = clusterVertexRanges[2 * cluster];
+    last = clusterVertexRanges[2 * cluster + 1];
+}
+
+void ClusterHierarchy::getVisibleClusters(const Matrix4x4 &transformMatrix, std::vector<size_t> &clusters) const {
+    Real planes[6][4];
+    std::vector<std::pair<size_t, unsigned>> stack;
+
+    clusters.clear();
+
+    if (nodes.empty()) {
+        return;
+    }
+
+    // Model positions have w equal to 1, a position is inside the plane p if p.x * x + p.y * y + p.z * z + p.w > 0
+    for (size_t i = 0; i < 3; ++i) {
+        for (size_t j = 0; j < 4; ++j) {
+            planes[2 * i][j] = transformMatrix.get(i, j) - transformMatrix.get(3, j);
+            planes[2 * i + 1][j] = -transformMatrix.get(i, j) - transformMatrix.get(3, j);
+        }
+    }
+
+    // Every node is tested against the planes its parent is not entirely inside of
+    stack.push_back(std::make_pair(size_t(0), 0x3Fu));
+
+    while (!stack.empty()) {
+        const node &n = nodes[stack.back().first];
+        unsigned planeMask = stack.back().second;
+        bool isOutside = false;
+
+        stack.pop_back();
+
+        for (size_t i = 0; i < 6 && !isOutside; ++i) {
+            if ((planeMask & (1u << i)) == 0) {
+                continue;
+            }
+
+            const Real *plane = planes[i];
+            Real nearest = plane[3], farthest = plane[3], margin = std::abs(plane[3]);
+
+            for (size_t j = 0; j < 3; ++j) {
+                const Real a = plane[j] * n.minimum[j];
+                const Real b = plane[j] * n.maximum[j];
+
+                nearest += std::min(a, b);
+                farthest += std::max(a, b);
+                margin += std::max(std::abs(a), std::abs(b));
+            }
+
+            margin *= planeMarginScale;
+
+            if (farthest + margin < 0) {
+                isOutside = true;
+            } else if (nearest - margin > 0) {
+                planeMask &= ~(1u << i);
+            }
+        }
+
+        if (isOutside) {
+            continue;
+        }
+
+        if (planeMask == 0 || n.children[0] == SIZE_MAX) {
+            clusters.insert(clusters.end(), clusterOrder.begin() + n.first, clusterOrder.begin() + n.last);
+        } else {
+            stack.push_back(std::make_pair(n.children[0], planeMask));
+            stack.push_back(std::make_pair(n.children[1], planeMask));
+        }
+    }
+
+    std::sort(clusters.begin(), clusters.end());
+}
+
+// Splits the clusters at the median of their box centers along the axis over which the centers spread the most
+size_t ClusterHierarchy::buildNode(size_t first, size_t last) {
+    node n;
+    Real centerMinimum[3], centerMaximum[3];
+
+    n.first = first;
+    n.last = last;
+    n.children[0] = SIZE_MAX;
+    n.children[1] = SIZE_MAX;
+
+    for (size_t j = 0; j < 3; ++j) {
+        n.minimum[j] = centerMinimum[j] = std::numeric_limits<Real>::infinity();
+        n.maximum[j] = centerMaximum[j] = -std::numeric_limits<Real>::infinity();
+    }
+
+    auto getCenter = [this](size_t cluster, size_t j) {
+        const Real center = (clusterBoxes[6 * cluster + j] + clusterBoxes[6 * cluster + 3 + j]) / 2;
+        return std::isfinite(center) ? center : Real(0);
+    };
+
+    for (size_t i = first; i < last; ++i) {
+        const Real *box = &clusterBoxes[6 * clusterOrder[i]];
+
+        for (size_t j = 0; j < 3; ++j) {
+            n.minimum[j] = std::min(n.minimum[j], box[j]);
+            n.maximum[j] = std::max(n.maximum[j], box[3 + j]);
+            centerMinimum[j] = std::min(centerMinimum[j], getCenter(clusterOrder[i], j));
+            centerMaximum[j] = std::max(centerMaximum[j], getCenter(clusterOrder[i], j));
+        }
+    }
+
+    const size_t index = nodes.size();
+    nodes.push_back(n);
+
+    if (last - first < 2) {
+        return index;
+    }
+
+    size_t axis = 0;
+
+    for (size_t j = 1; j < 3; ++j) {
+        if (centerMaximum[j] - centerMinimum[j] > centerMaximum[axis] - centerMinimum[axis]) {
+            axis = j;
+        }
+    }
+
+    const size_t middle = first + (last - first) / 2;
+
+    std::nth_element(clusterOrder.begin() + first, clusterOrder.begin() + middle, clusterOrder.begin() + last, [&](size_t a, size_t b) {
+        return getCenter(a, axis) < getCenter(b, axis);
+    });
+
+    const size_t left = buildNode(first, middle);
+    const size_t right = buildNode(middle, last);
+
+    nodes[index].children[0] = left;
+    nodes[index].children[1] = right;
+
+    return index;
+}
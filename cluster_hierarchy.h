@@ -0,0 +1,52 @@
+#ifndef CLUSTER_HIERARCHY_H
+#define CLUSTER_HIERARCHY_H
+
+#include <vector>
+#include "matrix4x4.h"
+#include "mesh.h"
+
+// Bounding volume hierarchy over clusters of consecutive triangles of a mesh. Clusters keep the triangle order
+// of the mesh, so culling them does not change which primitive wins a depth tie.
+class ClusterHierarchy {
+
+public:
+
+    static const size_t clusterTriangleCount = 256;
+
+    ClusterHierarchy();
+
+    void build(const Mesh &mesh);
+    void clear();
+
+    size_t getClusterCount() const;
+
+    // Triangles of the cluster refer only to vertexes from first to last - 1
+    void getClusterVertexRange(size_t cluster, size_t &first, size_t &last) const;
+
+    // Lists in ascending order the clusters which may be inside the clipping volume of the transform matrix,
+    // that is where w < x, y, z < -w for the transformed positions
+    void getVisibleClusters(const Matrix4x4 &transformMatrix, std::vector<size_t> &clusters) const;
+
+private:
+
+    // Boxes and ranges of the ordered clusters from first to last - 1, inner nodes have two children
+    struct node {
+        Real minimum[3];
+        Real maximum[3];
+        size_t first;
+        size_t last;
+        size_t children[2];
+    };
+
+    size_t buildNode(size_t first, size_t last);
+
+private:
+
+    std::vector<Real> clusterBoxes;
+    std::vector<size_t> clusterVertexRanges;
+    std::vector<size_t> clusterOrder;
+    std::vector<node> nodes;
+
+};
+
+#endif
@@ -0,0 +1,67 @@
+#include <algorithm>
+#include <cmath>
+#include "frame_statistics.h"
+
+void FrameStatistics::addTransformStatistics(const TransformEngine &transformEngine) {
+    transformTime += transformEngine.getTransformTime();
+    clipTime += transformEngine.getClipTime();
+    clippedTriangleCount += transformEngine.getClippedTriangleCount();
+}
+
+void FrameStatistics::setRenderStatistics(const RenderEngine &renderEngine) {
+    const RenderStatistics &renderStatistics = renderEngine.getRenderStatistics();
+
+    lightTime = renderStatistics.lightTime;
+    rasterTime = renderStatistics.rasterTime;
+    shadeTime = renderStatistics.shadeTime;
+    triangleCount = renderStatistics.triangleCount;
+    fragmentCount = renderStatistics.fragmentCount;
+    shadedPixelCount = renderStatistics.shadedPixelCount;
+}
+
+FrameTimeHistory::FrameTimeHistory(size_t capacity) {
+    this->capacity = std::max<size_t>(capacity, 1);
+    nextFrame = 0;
+}
+
+size_t FrameTimeHistory::getCapacity() const {
+    return capacity;
+}
+
+size_t FrameTimeHistory::getFrameCount() const {
+    return frameTimes.size();
+}
+
+double FrameTimeHistory::getFrameTime(size_t frame) const {
+    return frameTimes[(nextFrame + frame) % frameTimes.size()];
+}
+
+// Once full, the newest frame time replaces the oldest one
+void FrameTimeHistory::addFrameTime(double frameTime) {
+    if (frameTimes.size() < capacity) {
+        frameTimes.push_back(frameTime);
+        nextFrame = 0;
+    } else {
+        frameTimes[nextFrame] = frameTime;
+        nextFrame = (nextFrame + 1) % capacity;
+    }
+}
+
+void FrameTimeHistory::clear() {
+    frameTimes.clear();
+    nextFrame = 0;
+}
+
+double FrameTimeHistory::getPercentile(double percentile) const {
+    if (frameTimes.empty()) {
+        return 0;
+    }
+
+    std::vector<double> sortedFrameTimes(frameTimes);
+    const double rank = std::ceil(std::min(std::max(percentile, 0.0), 100.0) / 100 * sortedFrameTimes.size());
+    const size_t frame = rank > 1 ? static_cast<size_t>(rank) - 1 : 0;
+
+    std::nth_element(sortedFrameTimes.begin(), sortedFrameTimes.begin() + frame, sortedFrameTimes.end());
+
+    return sortedFrameTimes[frame];
+}
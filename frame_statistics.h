@@ -0,0 +1,57 @@
+#ifndef FRAME_STATISTICS_H
+#define FRAME_STATISTICS_H
+
+#include <vector>
+#include "render_engine.h"
+#include "transform_engine.h"
+
+// Wall time in milliseconds of one frame and of its stages, and the work done in them, gathered from the engines once
+// the frame is drawn. The frame time is measured by the application around the whole frame, the stages are a breakdown
+// of it. Presenting is timed by the application, it stays zero when rendering without a window. Reading is timed only
+// for streamed models, which are read again every frame.
+struct FrameStatistics {
+    double frameTime = 0;
+    double readTime = 0;
+    double transformTime = 0;
+    double clipTime = 0;
+    double lightTime = 0;
+    double rasterTime = 0;
+    double shadeTime = 0;
+    double presentTime = 0;
+    size_t triangleCount = 0;
+    size_t clippedTriangleCount = 0;
+    size_t fragmentCount = 0;
+    size_t shadedPixelCount = 0;
+
+    // Transform statistics are added, so that a frame drawn in batches counts every run of the engine
+    void addTransformStatistics(const TransformEngine &transformEngine);
+    void setRenderStatistics(const RenderEngine &renderEngine);
+};
+
+// Times of the last frames, kept so that rare slow frames show up in percentiles next to the typical frame time
+class FrameTimeHistory {
+
+public:
+
+    FrameTimeHistory(size_t capacity = 240);
+
+    size_t getCapacity() const;
+    size_t getFrameCount() const;
+
+    // Frames are counted from the oldest one kept
+    double getFrameTime(size_t frame) const;
+    void addFrameTime(double frameTime);
+    void clear();
+
+    // Nearest rank percentile of the kept frame times, e.g. 99 for the time 99% of the frames fit in
+    double getPercentile(double percentile) const;
+
+private:
+
+    size_t capacity;
+    std::vector<double> frameTimes;
+    size_t nextFrame;
+
+};
+
+#endif
@@ -0,0 +1,182 @@
+#include <algorithm>
+#include <array>
+#include <fstream>
+#include "image_writer.h"
+
+const char pngSignature[8] = { '\x89', 'P', 'N', 'G', '\r', '\n', '\x1a', '\n' };
+const size_t pngStoredBlockSize = 65535;
+
+// PNG chunks are at most 2^31 - 1 bytes long and the image is kept in one chunk
+const uint64_t pngMaximumDataSize = 0x7fff0000;
+
+static bool hasExtension(const std::string &filePath, const std::string &extension) {
+    return filePath.size() > extension.size() && filePath.compare(filePath.size() - extension.size(), extension.size(), extension) == 0;
+}
+
+static void appendBigEndian(uint32_t value, std::string &file) {
+    file.push_back(static_cast<char>(value >> 24));
+    file.push_back(static_cast<char>(value >> 16));
+    file.push_back(static_cast<char>(value >> 8));
+    file.push_back(static_cast<char>(value));
+}
+
+static std::array<uint32_t, 256> buildCrc32Table() {
+    std::array<uint32_t, 256> table;
+
+    for (uint32_t i = 0; i < 256; ++i) {
+        uint32_t value = i;
+
+        for (size_t j = 0; j < 8; ++j) {
+            value = (value & 1) != 0 ? 0xedb88320 ^ (value >> 1) : value >> 1;
+        }
+
+        table[i] = value;
+    }
+
+    return table;
+}
+
+// CRC-32 of PNG chunks, computed a byte at a time with a table built once on first use, which is safe when images
+// are saved from several threads
+static uint32_t getCrc32(const char *data, size_t size) {
+    static const std::array<uint32_t, 256> table = buildCrc32Table();
+
+    uint32_t crc = 0xffffffff;
+
+    for (size_t i = 0; i < size; ++i) {
+        crc = table[(crc ^ static_cast<uint8_t>(data[i])) & 0xff] ^ (crc >> 8);
+    }
+
+    return crc ^ 0xffffffff;
+}
+
+// Adler-32 of the zlib stream, the sums are reduced every 5552 bytes, the most which cannot overflow them
+static uint32_t getAdler32(const char *data, size_t size) {
+    uint32_t a = 1, b = 0;
+
+    while (size > 0) {
+        const size_t blockSize = size < 5552 ? size : 5552;
+
+        for (size_t i = 0; i < blockSize; ++i) {
+            a = a + static_cast<uint8_t>(data[i]);
+            b = b + a;
+        }
+
+        a = a % 65521;
+        b = b % 65521;
+        data = data + blockSize;
+        size = size - blockSize;
+    }
+
+    return (b << 16) | a;
+}
+
+static void appendPngChunk(const char *type, const std::string &data, std::string &file) {
+    appendBigEndian(static_cast<uint32_t>(data.size()), file);
+    const size_t typeOffset = file.size();
+    file.append(type, 4);
+    file.append(data);
+    appendBigEndian(getCrc32(file.data() + typeOffset, file.size() - typeOffset), file);
+}
+
+bool ImageWriter::saveToFile(const std::string &filePath, const std::vector<uint8_t> &image, size_t width, size_t height) {
+    std::string file;
+
+    saveError.clear();
+
+    if (width == 0 || height == 0 || image.size() < width * height * 4) {
+        saveError = "the image is empty or smaller than its size";
+        return false;
+    }
+
+    if (hasExtension(filePath, ".ppm")) {
+        encodePpm(image, width, height, file);
+    } else if (hasExtension(filePath, ".png")) {
+        if ((static_cast<uint64_t>(width) * 4 + 1) * height > pngMaximumDataSize) {
+            saveError = "the image is too large for PNG";
+            return false;
+        }
+
+        encodePng(image, width, height, file);
+    } else {
+        saveError = "unknown image format, the file has to end with .ppm or .png";
+        return false;
+    }
+
+    std::ofstream stream(filePath, std::ios::binary);
+
+    if (!stream.is_open()) {
+        saveError = "cannot open the file for writing";
+        return false;
+    }
+
+    stream.write(file.data(), file.size());
+
+    if (!stream) {
+        saveError = "cannot write the file";
+        return false;
+    }
+
+    return true;
+}
+
+const std::string& ImageWriter::getSaveError() const {
+    return saveError;
+}
+
+void ImageWriter::encodePpm(const std::vector<uint8_t> &image, size_t width, size_t height, std::string &file) const {
+    file = "P6\n" + std::to_string(width) + " " + std::to_string(height) + "\n255\n";
+    file.reserve(file.size() + width * height * 3);
+
+    for (size_t i = 0; i < width * height; ++i) {
+        file.append(reinterpret_cast<const char*>(image.data() + i * 4), 3);
+    }
+}
+
+void ImageWriter::encodePng(const std::vector<uint8_t> &image, size_t width, size_t height, std::string &file) const {
+    const size_t rowSize = width * 4;
+    std::string header, pixels, data;
+
+    appendBigEndian(static_cast<uint32_t>(width), header);
+    appendBigEndian(static_cast<uint32_t>(height), header);
+    header.push_back(8); // Bit depth
+    header.push_back(6); // RGBA
+    header.push_back(0); // Compression
+    header.push_back(0); // Filter
+    header.push_back(0); // Interlace
+
+    // Every row starts with its filter type, rows are not filtered
+    pixels.reserve((rowSize + 1) * height);
+
+    for (size_t y = 0; y < height; ++y) {
+        pixels.push_back(0);
+        pixels.append(reinterpret_cast<const char*>(image.data() + y * rowSize), rowSize);
+    }
+
+    // The zlib stream holds the rows in stored deflate blocks, each one starting with its final block flag and its
+    // little endian size followed by the complement of the size
+    const size_t blockCount = (pixels.size() + pngStoredBlockSize - 1) / pngStoredBlockSize;
+
+    data.reserve(pixels.size() + blockCount * 5 + 6);
+    data.push_back(0x78);
+    data.push_back(0x01);
+
+    for (size_t block = 0; block < blockCount; ++block) {
+        const size_t offset = block * pngStoredBlockSize;
+        const size_t size = std::min(pixels.size() - offset, pngStoredBlockSize);
+
+        data.push_back(block + 1 == blockCount ? 1 : 0);
+        data.push_back(static_cast<char>(size & 0xff));
+        data.push_back(static_cast<char>(size >> 8));
+        data.push_back(static_cast<char>(~size & 0xff));
+        data.push_back(static_cast<char>((~size >> 8) & 0xff));
+        data.append(pixels, offset, size);
+    }
+
+    appendBigEndian(getAdler32(pixels.data(), pixels.size()), data);
+
+    file.assign(pngSignature, sizeof(pngSignature));
+    appendPngChunk("IHDR", header, file);
+    appendPngChunk("IDAT", data, file);
+    appendPngChunk("IEND", std::string(), file);
+}
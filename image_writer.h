@@ -0,0 +1,31 @@
+#ifndef IMAGE_WRITER_H
+#define IMAGE_WRITER_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Saves packed RGBA8 images, the first row of which is the top of the image, without a windowing library.
+// Files ending with .ppm are saved as binary PPM, which drops alpha, and files ending with .png are saved as PNG.
+// PNG files keep the pixels uncompressed in stored deflate blocks, so they are large but quick to write.
+class ImageWriter {
+
+public:
+
+    bool saveToFile(const std::string &filePath, const std::vector<uint8_t> &image, size_t width, size_t height);
+
+    // Reason saving failed
+    const std::string& getSaveError() const;
+
+private:
+
+    void encodePpm(const std::vector<uint8_t> &image, size_t width, size_t height, std::string &file) const;
+    void encodePng(const std::vector<uint8_t> &image, size_t width, size_t height, std::string &file) const;
+
+private:
+
+    std::string saveError;
+
+};
+
+#endif
@@ -1,10 +1,190 @@
 #include <algorithm>
 #include <cmath>
+#include <cstdint>
+#include <cstring>
 #include <fstream>
-#include <sstream>
+#include <limits>
 #include "light_engine.h"
+#include "text_scanner.h"
+#if defined(__AVX2__) && !defined(USE_SCALAR_LIGHTING)
+#include <immintrin.h>
+#elif defined(__SSE2__) && !defined(USE_SCALAR_LIGHTING)
+#include <emmintrin.h>
+#endif
+
+// Grid cells are about as large as a typical light radius, lights much larger than that are not binned
+const size_t maxLightGridSize = 64;
+const Real globalLightRadiusRatio = 8.0;
+
+// Batch lighting runs on as many floats at once as the target supports, eight with AVX2, four with SSE2,
+// USE_SCALAR_LIGHTING makes it run on one float at a time, so that the fallback can be checked on any target
+#if defined(__AVX2__) && !defined(USE_SCALAR_LIGHTING)
+const size_t laneCount = 8;
+const char batchInstructionSet[] = "AVX2";
+
+struct lanes {
+    __m256 value;
+};
+
+inline lanes broadcastLanes(float value) { return { _mm256_set1_ps(value) }; }
+inline lanes loadLanes(const float *values) { return { _mm256_loadu_ps(values) }; }
+inline void storeLanes(float *values, lanes a) { _mm256_storeu_ps(values, a.value); }
+inline lanes operator+(lanes a, lanes b) { return { _mm256_add_ps(a.value, b.value) }; }
+inline lanes operator-(lanes a, lanes b) { return { _mm256_sub_ps(a.value, b.value) }; }
+inline lanes operator*(lanes a, lanes b) { return { _mm256_mul_ps(a.value, b.value) }; }
+inline lanes operator/(lanes a, lanes b) { return { _mm256_div_ps(a.value, b.value) }; }
+inline lanes operator&(lanes a, lanes b) { return { _mm256_and_ps(a.value, b.value) }; }
+inline lanes operator>(lanes a, lanes b) { return { _mm256_cmp_ps(a.value, b.value, _CMP_GT_OQ) }; }
+inline lanes operator<=(lanes a, lanes b) { return { _mm256_cmp_ps(a.value, b.value, _CMP_LE_OQ) }; }
+inline lanes sqrtLanes(lanes a) { return { _mm256_sqrt_ps(a.value) }; }
+inline lanes minLanes(lanes a, lanes b) { return { _mm256_min_ps(a.value, b.value) }; }
+inline lanes maxLanes(lanes a, lanes b) { return { _mm256_max_ps(a.value, b.value) }; }
+inline lanes selectLanes(lanes mask, lanes a, lanes b) { return { _mm256_blendv_ps(b.value, a.value, mask.value) }; }
+inline bool anyLanes(lanes mask) { return _mm256_movemask_ps(mask.value) != 0; }
+
+// Unbiased exponent and mantissa in [1, 2) of positive normal floats
+inline lanes exponentLanes(lanes a) {
+    const __m256i bits = _mm256_srli_epi32(_mm256_castps_si256(a.value), 23);
+    return { _mm256_cvtepi32_ps(_mm256_sub_epi32(bits, _mm256_set1_epi32(127))) };
+}
+
+inline lanes mantissaLanes(lanes a) {
+    const __m256i bits = _mm256_and_si256(_mm256_castps_si256(a.value), _mm256_set1_epi32(0x007fffff));
+    return { _mm256_castsi256_ps(_mm256_or_si256(bits, _mm256_set1_epi32(0x3f800000))) };
+}
+
+// Whole and fractional part of non negative floats, and two to the power of a whole float in [-126, 127]
+inline lanes truncateLanes(lanes a) { return { _mm256_cvtepi32_ps(_mm256_cvttps_epi32(a.value)) }; }
+
+inline lanes powerOfTwoLanes(lanes a) {
+    const __m256i bits = _mm256_add_epi32(_mm256_cvttps_epi32(a.value), _mm256_set1_epi32(127));
+    return { _mm256_castsi256_ps(_mm256_slli_epi32(bits, 23)) };
+}
+#elif defined(__SSE2__) && !defined(USE_SCALAR_LIGHTING)
+const size_t laneCount = 4;
+const char batchInstructionSet[] = "SSE2";
+
+struct lanes {
+    __m128 value;
+};
+
+inline lanes broadcastLanes(float value) { return { _mm_set1_ps(value) }; }
+inline lanes loadLanes(const float *values) { return { _mm_loadu_ps(values) }; }
+inline void storeLanes(float *values, lanes a) { _mm_storeu_ps(values, a.value); }
+inline lanes operator+(lanes a, lanes b) { return { _mm_add_ps(a.value, b.value) }; }
+inline lanes operator-(lanes a, lanes b) { return { _mm_sub_ps(a.value, b.value) }; }
+inline lanes operator*(lanes a, lanes b) { return { _mm_mul_ps(a.value, b.value) }; }
+inline lanes operator/(lanes a, lanes b) { return { _mm_div_ps(a.value, b.value) }; }
+inline lanes operator&(lanes a, lanes b) { return { _mm_and_ps(a.value, b.value) }; }
+inline lanes operator>(lanes a, lanes b) { return { _mm_cmpgt_ps(a.value, b.value) }; }
+inline lanes operator<=(lanes a, lanes b) { return { _mm_cmple_ps(a.value, b.value) }; }
+inline lanes sqrtLanes(lanes a) { return { _mm_sqrt_ps(a.value) }; }
+inline lanes minLanes(lanes a, lanes b) { return { _mm_min_ps(a.value, b.value) }; }
+inline lanes maxLanes(lanes a, lanes b) { return { _mm_max_ps(a.value, b.value) }; }
+inline lanes selectLanes(lanes mask, lanes a, lanes b) { return { _mm_or_ps(_mm_and_ps(mask.value, a.value), _mm_andnot_ps(mask.value, b.value)) }; }
+inline bool anyLanes(lanes mask) { return _mm_movemask_ps(mask.value) != 0; }
+
+inline lanes exponentLanes(lanes a) {
+    const __m128i bits = _mm_srli_epi32(_mm_castps_si128(a.value), 23);
+    return { _mm_cvtepi32_ps(_mm_sub_epi32(bits, _mm_set1_epi32(127))) };
+}
+
+inline lanes mantissaLanes(lanes a) {
+    const __m128i bits = _mm_and_si128(_mm_castps_si128(a.value), _mm_set1_epi32(0x007fffff));
+    return { _mm_castsi128_ps(_mm_or_si128(bits, _mm_set1_epi32(0x3f800000))) };
+}
+
+inline lanes truncateLanes(lanes a) { return { _mm_cvtepi32_ps(_mm_cvttps_epi32(a.value)) }; }
+
+inline lanes powerOfTwoLanes(lanes a) {
+    const __m128i bits = _mm_add_epi32(_mm_cvttps_epi32(a.value), _mm_set1_epi32(127));
+    return { _mm_castsi128_ps(_mm_slli_epi32(bits, 23)) };
+}
+#else
+const size_t laneCount = 1;
+const char batchInstructionSet[] = "scalar";
+
+struct lanes {
+    float value;
+};
+
+inline lanes broadcastLanes(float value) { return { value }; }
+inline lanes loadLanes(const float *values) { return { *values }; }
+inline void storeLanes(float *values, lanes a) { *values = a.value; }
+inline lanes operator+(lanes a, lanes b) { return { a.value + b.value }; }
+inline lanes operator-(lanes a, lanes b) { return { a.value - b.value }; }
+inline lanes operator*(lanes a, lanes b) { return { a.value * b.value }; }
+inline lanes operator/(lanes a, lanes b) { return { a.value / b.value }; }
+inline lanes operator&(lanes a, lanes b) { return { a.value != 0.0f && b.value != 0.0f ? 1.0f : 0.0f }; }
+inline lanes operator>(lanes a, lanes b) { return { a.value > b.value ? 1.0f : 0.0f }; }
+inline lanes operator<=(lanes a, lanes b) { return { a.value <= b.value ? 1.0f : 0.0f }; }
+inline lanes sqrtLanes(lanes a) { return { std::sqrt(a.value) }; }
+inline lanes minLanes(lanes a, lanes b) { return { std::min(a.value, b.value) }; }
+inline lanes maxLanes(lanes a, lanes b) { return { std::max(a.value, b.value) }; }
+inline lanes selectLanes(lanes mask, lanes a, lanes b) { return mask.value != 0.0f ? a : b; }
+inline bool anyLanes(lanes mask) { return mask.value != 0.0f; }
+
+inline lanes exponentLanes(lanes a) {
+    uint32_t bits;
+    std::memcpy(&bits, &a.value, sizeof(bits));
+    return { static_cast<float>(static_cast<int32_t>(bits >> 23) - 127) };
+}
+
+inline lanes mantissaLanes(lanes a) {
+    uint32_t bits;
+    std::memcpy(&bits, &a.value, sizeof(bits));
+    bits = (bits & 0x007fffff) | 0x3f800000;
+    std::memcpy(&a.value, &bits, sizeof(bits));
+    return a;
+}
+
+inline lanes truncateLanes(lanes a) { return { static_cast<float>(static_cast<int32_t>(a.value)) }; }
+
+inline lanes powerOfTwoLanes(lanes a) {
+    const uint32_t bits = static_cast<uint32_t>(static_cast<int32_t>(a.value) + 127) << 23;
+    std::memcpy(&a.value, &bits, sizeof(bits));
+    return a;
+}
+#endif
+
+// Base two logarithm of positive normal floats, absolute error below 1.4e-6
+inline lanes log2Lanes(lanes a) {
+    const float coefficients[] = { 0.0204903378f, -0.0960662244f, 0.215588504f, -0.339247758f, 0.477705927f, -0.721162734f, 1.44269326f };
+    const lanes x = mantissaLanes(a) - broadcastLanes(1.0f);
+    lanes polynomial = broadcastLanes(coefficients[0]);
+
+    for (size_t i = 1; i < sizeof(coefficients) / sizeof(coefficients[0]); ++i) {
+        polynomial = polynomial * x + broadcastLanes(coefficients[i]);
+    }
+
+    return exponentLanes(a) + polynomial * x;
+}
+
+// Two to the power of floats in [-126, 0], relative error below 1e-8
+inline lanes exp2Lanes(lanes a) {
+    const float coefficients[] = { 0.000208291396f, 0.00126893652f, 0.00965243955f, 0.0554959365f, 0.240227215f, 0.693147171f };
+    const lanes shifted = maxLanes(a, broadcastLanes(-126.0f)) + broadcastLanes(126.0f);
+    const lanes whole = truncateLanes(shifted);
+    const lanes x = shifted - whole;
+    lanes polynomial = broadcastLanes(coefficients[0]);
+
+    for (size_t i = 1; i < sizeof(coefficients) / sizeof(coefficients[0]); ++i) {
+        polynomial = polynomial * x + broadcastLanes(coefficients[i]);
+    }
+
+    return powerOfTwoLanes(whole - broadcastLanes(126.0f)) * (broadcastLanes(1.0f) + polynomial * x);
+}
+
+// Divides by the length where it is positive and returns zero elsewhere, like Vector4::normalize does
+inline lanes inverseLengthLanes(lanes x, lanes y, lanes z) {
+    const lanes length = sqrtLanes(x * x + y * y + z * z);
+    const lanes zero = broadcastLanes(0.0f);
+    return selectLanes(length > zero, broadcastLanes(1.0f) / maxLanes(length, broadcastLanes(std::numeric_limits<float>::min())), zero);
+}
 
 LightEngine::LightEngine() {
+    revision = 0;
+    lightCullingThreshold = 0.0;
     loadMaterialFromValues();
 }
 
@@ -16,7 +196,7 @@ void LightEngine::setViewTranslation(Vector4 viewTranslation) {
     this->viewTranslation = viewTranslation;
 }
 
-void LightEngine::setViewTranslation(double x, double y, double z) {
+void LightEngine::setViewTranslation(Real x, Real y, Real z) {
     setViewTranslation(Vector4(x, y, z));
 }
 
@@ -24,53 +204,42 @@ void LightEngine::loadLightSourcesFromArray(const std::vector <LightSource> &lig
     this->lightSources.clear();
     this->lightSources.insert(this->lightSources.end(), lightSources.begin(), lightSources.end());
     this->ambientLight = ambientLight;
+    ++revision;
+    buildLightGrid();
 }
 
 bool LightEngine::loadLightSourcesFromBuffer(const std::string &buffer) {
-    std::stringstream stream(buffer);
-    std::string lineBuffer;
+    TextScanner scanner(buffer.data(), buffer.data() + buffer.size());
     std::vector <LightSource> lightSources;
 
-    while (std::getline(stream, lineBuffer)) {
-        // Left trim
-        lineBuffer.erase(lineBuffer.begin(), std::find_if(lineBuffer.begin(), lineBuffer.end(), [](int c) {
-            return !std::isspace(c);
-        }));
+    loadError.clear();
 
-        // Right trim
-        lineBuffer.erase(std::find_if(lineBuffer.rbegin(), lineBuffer.rend(), [](int c) {
-            return !std::isspace(c);
-        }).base(), lineBuffer.end());
-
-        // Empty line or comment
-        if (lineBuffer.empty() || lineBuffer[0] == '#') {
-            continue;
-        }
-
-        std::stringstream lineStream(lineBuffer);
+    while (scanner.nextLine()) {
         LightSource lightSource;
 
-        lineStream >> lightSource.intensity;
+        scanner.read(lightSource.intensity);
 
-        if (lineStream.fail()) {
+        if (scanner.fail()) {
+            loadError = "line " + std::to_string(scanner.getLineNumber()) + " is not a valid light source";
             return false;
         }
 
-        lineStream >> lightSource.position.x();
-        lineStream >> lightSource.position.y();
-        lineStream >> lightSource.position.z();
+        scanner.read(lightSource.position.x());
+        scanner.read(lightSource.position.y());
+        scanner.read(lightSource.position.z());
         lightSource.position.w() = 0.0;
 
-        if (lineStream.fail()) {
+        if (scanner.fail()) {
+            loadError = "line " + std::to_string(scanner.getLineNumber()) + " is not a valid light source";
             return false;
         }
 
-        lineStream >> lightSource.color.x();
-        lineStream >> lightSource.color.y();
-        lineStream >> lightSource.color.z();
+        scanner.read(lightSource.color.x());
+        scanner.read(lightSource.color.y());
+        scanner.read(lightSource.color.z());
         lightSource.color.w() = 1.0;
 
-        if (lineStream.fail()) {
+        if (scanner.fail()) {
             lightSource.color = Vector4(1.0, 1.0, 1.0, 1.0);
         }
         
@@ -90,6 +259,8 @@ bool LightEngine::loadLightSourcesFromBuffer(const std::string &buffer) {
 }
 
 bool LightEngine::loadLightSourcesFromFile(const std::string &filePath) {
+    loadError.clear();
+
     if (filePath.empty()) {
         return true;
     }
@@ -102,88 +273,59 @@ bool LightEngine::loadLightSourcesFromFile(const std::string &filePath) {
         return loadLightSourcesFromBuffer(buffer);
     }
 
+    loadError = "cannot open the file";
+
     return false;
 }
 
-void LightEngine::loadMaterialFromValues(Vector4 ambientReflection, Vector4 diffuseReflection, Vector4 specularReflection, double shininess, double suppression) {
+void LightEngine::loadMaterialFromValues(Vector4 ambientReflection, Vector4 diffuseReflection, Vector4 specularReflection, Real shininess, Real suppression) {
     for (size_t i = 0; i < 4; ++i) {
-        this->ambientReflection[i] = std::min(std::max(ambientReflection.c(i), 0.0), 1.0);
-        this->diffuseReflection[i] = std::max(diffuseReflection.c(i), 0.0);
-        this->specularReflection[i] = std::max(specularReflection.c(i), 0.0);
+        this->ambientReflection[i] = std::min(std::max(ambientReflection.c(i), Real(0)), Real(1));
+        this->diffuseReflection[i] = std::max(diffuseReflection.c(i), Real(0));
+        this->specularReflection[i] = std::max(specularReflection.c(i), Real(0));
     }
     
-    this->shininess = std::max(shininess, 0.0);
-    this->suppression = std::max(suppression, 0.0);
+    this->shininess = std::max(shininess, Real(0));
+    this->suppression = std::max(suppression, Real(0));
+    ++revision;
+    buildLightGrid();
 }
 
 bool LightEngine::loadMaterialFromBuffer(const std::string &buffer) {
-    std::stringstream stream(buffer);
-    std::string lineBuffer;
+    TextScanner scanner(buffer.data(), buffer.data() + buffer.size());
     std::vector<Vector4> vectorValues;
-    std::vector<double> scalarValues;
+    std::vector<Real> scalarValues;
 
-    while (vectorValues.size() < 3 && std::getline(stream, lineBuffer)) {
-        // Left trim
-        lineBuffer.erase(lineBuffer.begin(), std::find_if(lineBuffer.begin(), lineBuffer.end(), [](int c) {
-            return !std::isspace(c);
-        }));
+    loadError.clear();
 
-        // Right trim
-        lineBuffer.erase(std::find_if(lineBuffer.rbegin(), lineBuffer.rend(), [](int c) {
-            return !std::isspace(c);
-        }).base(), lineBuffer.end());
-
-        // Empty line or comment
-        if (lineBuffer.empty() || lineBuffer[0] == '#') {
-            continue;
-        }
-
-        std::stringstream lineStream(lineBuffer);
+    while (vectorValues.size() < 3 && scanner.nextLine()) {
         Vector4 value;
 
-        lineStream >> value.x();
-        lineStream >> value.y();
-        lineStream >> value.z();
+        scanner.read(value.x());
+        scanner.read(value.y());
+        scanner.read(value.z());
 
-        if (lineStream.fail()) {
+        if (scanner.fail()) {
+            loadError = "line " + std::to_string(scanner.getLineNumber()) + " is not a valid reflection";
             return false;
         }
         
-        lineStream >> value.w();
+        scanner.read(value.w());
 
-        if (lineStream.fail()) {
+        if (scanner.fail()) {
             value.w() = 1.0;
         }
 
         vectorValues.push_back(value);
     }
 
-    if (vectorValues.size() < 3) {
-        return false;
-    }
-
-    while (scalarValues.size() < 2 && std::getline(stream, lineBuffer)) {
-        // Left trim
-        lineBuffer.erase(lineBuffer.begin(), std::find_if(lineBuffer.begin(), lineBuffer.end(), [](int c) {
-            return !std::isspace(c);
-        }));
-
-        // Right trim
-        lineBuffer.erase(std::find_if(lineBuffer.rbegin(), lineBuffer.rend(), [](int c) {
-            return !std::isspace(c);
-        }).base(), lineBuffer.end());
-
-        // Empty line or comment
-        if (lineBuffer.empty() || lineBuffer[0] == '#') {
-            continue;
-        }
+    while (vectorValues.size() == 3 && scalarValues.size() < 2 && scanner.nextLine()) {
+        Real value;
 
-        std::stringstream lineStream(lineBuffer);
-        double value;
+        scanner.read(value);
 
-        lineStream >> value;
-
-        if (lineStream.fail()) {
+        if (scanner.fail()) {
+            loadError = "line " + std::to_string(scanner.getLineNumber()) + " is not a valid shininess or suppression";
             return false;
         }
         
@@ -191,6 +333,7 @@ bool LightEngine::loadMaterialFromBuffer(const std::string &buffer) {
     }
 
     if (scalarValues.size() < 2) {
+        loadError = "the material ends after line " + std::to_string(scanner.getLineNumber()) + ", before all of its values";
         return false;
     }
 
@@ -200,6 +343,8 @@ bool LightEngine::loadMaterialFromBuffer(const std::string &buffer) {
 }
 
 bool LightEngine::loadMaterialFromFile(const std::string &filePath) {
+    loadError.clear();
+
     if (filePath.empty()) {
         return true;
     }
@@ -212,26 +357,120 @@ bool LightEngine::loadMaterialFromFile(const std::string &filePath) {
         return loadMaterialFromBuffer(buffer);
     }
 
+    loadError = "cannot open the file";
+
     return false;
 }
 
+Real LightEngine::getLightCullingThreshold() const {
+    return lightCullingThreshold;
+}
+
+void LightEngine::setLightCullingThreshold(Real lightCullingThreshold) {
+    this->lightCullingThreshold = std::max(lightCullingThreshold, Real(0));
+    ++revision;
+    buildLightGrid();
+}
+
+const std::string& LightEngine::getLoadError() const {
+    return loadError;
+}
+
+size_t LightEngine::getRevision() const {
+    return revision;
+}
+
 Vector4 LightEngine::getLight(Vector4 position, Vector4 normal) const {
-    Vector4 light = Vector4(1.0, 1.0, 1.0, 1.0);
-    
+    Vector4 light = getViewIndependentLight(position, normal);
+    Vector4 specularLight = getSpecularLight(position, normal);
+
+    for (size_t i = 0; i < 4; ++i) {
+        light[i] = std::min(light[i] + specularLight[i], Real(1));
+    }
+
+    return light;
+}
+
+Vector4 LightEngine::getViewIndependentLight(Vector4 position, Vector4 normal) const {
+    Vector4 light;
+
     for (size_t i = 0; i < 4; ++i) {
         light[i] = ambientLight.intensity * ambientReflection.c(i) * ambientLight.color.c(i);
     }
-    
+
     normal.w() = 0.0;
     normal.normalize();
-    
+
     if (normal.getLength() == 0.0) {
         return light;
     }
-    
-    for (const auto& lightSource : lightSources) {
+
+    const size_t *cellLights;
+    size_t cellLightCount;
+    getCellLights(position, cellLights, cellLightCount);
+
+    for (size_t j = 0; j < globalLights.size() + cellLightCount; ++j) {
         // TODO ray casting
 
+        Real distance;
+        const LightSource *reachingLight = getReachingLight(j, cellLights, position, distance);
+
+        if (reachingLight == nullptr) {
+            continue;
+        }
+
+        const LightSource &lightSource = *reachingLight;
+        Vector4 lightDirection;
+
+        for (size_t i = 0; i < 3; ++i) {
+            lightDirection[i] = lightSource.position.c(i) - position.c(i);
+        }
+
+        lightDirection.normalize();
+
+        Real distanceSuppression = 1 / (suppression + distance);
+        Real cosDiffuseAngle =
+            normal.cx() * lightDirection.cx() +
+            normal.cy() * lightDirection.cy() +
+            normal.cz() * lightDirection.cz();
+
+        if (cosDiffuseAngle > 0.0) {
+            for (size_t i = 0; i < 4; ++i) {
+                light[i] += lightSource.intensity * distanceSuppression * diffuseReflection.c(i) * cosDiffuseAngle * lightSource.color.c(i);
+            }
+        }
+    }
+
+    return light;
+}
+
+Vector4 LightEngine::getSpecularLight(Vector4 position, Vector4 normal) const {
+    Vector4 light;
+
+    if (specularReflection.getLength() == 0.0) {
+        return light;
+    }
+
+    normal.w() = 0.0;
+    normal.normalize();
+
+    if (normal.getLength() == 0.0) {
+        return light;
+    }
+
+    const size_t *cellLights;
+    size_t cellLightCount;
+    getCellLights(position, cellLights, cellLightCount);
+
+    for (size_t j = 0; j < globalLights.size() + cellLightCount; ++j) {
+        Real distance;
+        const LightSource *reachingLight = getReachingLight(j, cellLights, position, distance);
+
+        if (reachingLight == nullptr) {
+            continue;
+        }
+
+        const LightSource &lightSource = *reachingLight;
         Vector4 lightDirection, reflectionDirection, viewerDirection;
 
         for (size_t i = 0; i < 3; ++i) {
@@ -240,37 +479,339 @@ Vector4 LightEngine::getLight(Vector4 position, Vector4 normal) const {
             viewerDirection[i] = viewTranslation.c(i) - position.c(i);
         }
 
-        lightDirection.normalize();
         reflectionDirection.normalize();
         viewerDirection.normalize();
 
-        double distance = sqrt(
-            pow(position.cx() - lightSource.position.cx(), 2) +
-            pow(position.cy() - lightSource.position.cy(), 2) +
-            pow(position.cz() - lightSource.position.cz(), 2));
-        double distanceSuppression = 1 / (suppression + distance);
-        double cosDiffuseAngle =
-            normal.cx() * lightDirection.cx() +
-            normal.cy() * lightDirection.cy() +
-            normal.cz() * lightDirection.cz();
-        double cosSpecularAngle =
+        Real distanceSuppression = 1 / (suppression + distance);
+        Real cosSpecularAngle =
             reflectionDirection.cx() * viewerDirection.cx() +
             reflectionDirection.cy() * viewerDirection.cy() +
             reflectionDirection.cz() * viewerDirection.cz();
-        
-        for (size_t i = 0; i < 4; ++i) {
-            if (cosDiffuseAngle > 0.0) {
-                light[i] += lightSource.intensity * distanceSuppression * diffuseReflection.c(i) * cosDiffuseAngle * lightSource.color.c(i);
-            }
-            if (cosSpecularAngle > 0.0) {
+
+        if (cosSpecularAngle > 0.0) {
+            for (size_t i = 0; i < 4; ++i) {
                 light[i] += lightSource.intensity * distanceSuppression * specularReflection.c(i) * pow(cosSpecularAngle, shininess);
             }
         }
     }
 
-    for (size_t i = 0; i < 4; ++i) {
-        light[i] = std::min(light[i], 1.0);
+    return light;
+}
+
+void LightEngine::buildLightGrid() {
+    lightRadiuses.assign(lightSources.size(), std::numeric_limits<Real>::infinity());
+    globalLights.clear();
+    lightGridOffsets.clear();
+    lightGridLights.clear();
+    lightGridSize[0] = lightGridSize[1] = lightGridSize[2] = 0;
+
+    // Contribution of a light is at most intensity / (suppression + distance) times the largest reflection
+    std::vector<Real> finiteRadiuses;
+
+    for (size_t i = 0; i < lightSources.size(); ++i) {
+        Real maxReflection = 0.0;
+
+        for (size_t j = 0; j < 4; ++j) {
+            maxReflection = std::max(maxReflection, diffuseReflection.c(j) * lightSources[i].color.c(j) + specularReflection.c(j));
+        }
+
+        if (lightCullingThreshold > 0.0) {
+            lightRadiuses[i] = std::max(std::abs(lightSources[i].intensity) * maxReflection / lightCullingThreshold - suppression, Real(0));
+            finiteRadiuses.push_back(lightRadiuses[i]);
+        }
     }
 
-    return light;
+    if (finiteRadiuses.empty()) {
+        for (size_t i = 0; i < lightSources.size(); ++i) {
+            globalLights.push_back(i);
+        }
+        return;
+    }
+
+    std::nth_element(finiteRadiuses.begin(), finiteRadiuses.begin() + finiteRadiuses.size() / 2, finiteRadiuses.end());
+    const Real typicalRadius = finiteRadiuses[finiteRadiuses.size() / 2];
+    Vector4 minimum(std::numeric_limits<Real>::infinity(), std::numeric_limits<Real>::infinity(), std::numeric_limits<Real>::infinity());
+    Vector4 maximum(-minimum.cx(), -minimum.cy(), -minimum.cz());
+    std::vector<size_t> binnedLights;
+
+    for (size_t i = 0; i < lightSources.size(); ++i) {
+        if (!(lightRadiuses[i] <= globalLightRadiusRatio * typicalRadius)) {
+            globalLights.push_back(i);
+            continue;
+        }
+
+        binnedLights.push_back(i);
+
+        for (size_t j = 0; j < 3; ++j) {
+            minimum[j] = std::min(minimum.c(j), lightSources[i].position.c(j) - lightRadiuses[i]);
+            maximum[j] = std::max(maximum.c(j), lightSources[i].position.c(j) + lightRadiuses[i]);
+        }
+    }
+
+    if (binnedLights.empty()) {
+        return;
+    }
+
+    const Real extent = std::max(std::max(maximum.cx() - minimum.cx(), maximum.cy() - minimum.cy()), maximum.cz() - minimum.cz());
+    lightGridOrigin = minimum;
+    lightGridCellSize = std::max(std::max(typicalRadius, extent / maxLightGridSize), Real(1e-9));
+
+    for (size_t j = 0; j < 3; ++j) {
+        lightGridSize[j] = std::min(static_cast<size_t>((maximum.c(j) - minimum.c(j)) / lightGridCellSize) + 1, maxLightGridSize);
+    }
+
+    // Lights are binned twice, first to size the cells and then to fill them
+    lightGridOffsets.assign(lightGridSize[0] * lightGridSize[1] * lightGridSize[2] + 1, 0);
+    std::vector<size_t> cellSlots;
+
+    for (size_t pass = 0; pass < 2; ++pass) {
+        for (const size_t i : binnedLights) {
+            size_t first[3], last[3];
+
+            for (size_t j = 0; j < 3; ++j) {
+                first[j] = std::min(static_cast<size_t>((lightSources[i].position.c(j) - lightRadiuses[i] - minimum.c(j)) / lightGridCellSize), lightGridSize[j] - 1);
+                last[j] = std::min(static_cast<size_t>((lightSources[i].position.c(j) + lightRadiuses[i] - minimum.c(j)) / lightGridCellSize), lightGridSize[j] - 1);
+            }
+
+            for (size_t z = first[2]; z <= last[2]; ++z) {
+                for (size_t y = first[1]; y <= last[1]; ++y) {
+                    for (size_t x = first[0]; x <= last[0]; ++x) {
+                        const size_t cell = (z * lightGridSize[1] + y) * lightGridSize[0] + x;
+
+                        if (pass == 0) {
+                            ++lightGridOffsets[cell + 1];
+                        } else {
+                            lightGridLights[cellSlots[cell]++] = i;
+                        }
+                    }
+                }
+            }
+        }
+
+        if (pass == 0) {
+            for (size_t cell = 0; cell + 1 < lightGridOffsets.size(); ++cell) {
+                lightGridOffsets[cell + 1] += lightGridOffsets[cell];
+            }
+
+            lightGridLights.resize(lightGridOffsets.back());
+            cellSlots.assign(lightGridOffsets.begin(), lightGridOffsets.end() - 1);
+        }
+    }
+}
+
+void LightEngine::getCellLights(Vector4 position, const size_t *&cellLights, size_t &cellLightCount) const {
+    cellLights = nullptr;
+    cellLightCount = 0;
+
+    if (lightGridOffsets.empty()) {
+        return;
+    }
+
+    size_t cell[3];
+
+    for (size_t j = 0; j < 3; ++j) {
+        const Real offset = (position.c(j) - lightGridOrigin.c(j)) / lightGridCellSize;
+
+        // Also rejects NaN coordinates
+        if (!(offset >= 0.0 && offset < lightGridSize[j])) {
+            return;
+        }
+
+        cell[j] = static_cast<size_t>(offset);
+    }
+
+    const size_t index = (cell[2] * lightGridSize[1] + cell[1]) * lightGridSize[0] + cell[0];
+    cellLights = lightGridLights.data() + lightGridOffsets[index];
+    cellLightCount = lightGridOffsets[index + 1] - lightGridOffsets[index];
+}
+
+// Returns the i-th light from the global and cell lists if it reaches the position
+const LightSource* LightEngine::getReachingLight(size_t i, const size_t *cellLights, Vector4 position, Real &distance) const {
+    const size_t lightIndex = i < globalLights.size() ? globalLights[i] : cellLights[i - globalLights.size()];
+    const LightSource &lightSource = lightSources[lightIndex];
+
+    distance = sqrt(
+        pow(position.cx() - lightSource.position.cx(), 2) +
+        pow(position.cy() - lightSource.position.cy(), 2) +
+        pow(position.cz() - lightSource.position.cz(), 2));
+
+    if (distance > lightRadiuses[lightIndex]) {
+        return nullptr;
+    }
+
+    return &lightSource;
+}
+
+void LightEngine::getLights(size_t count, const float *const positions[3], const float *const normals[3], float *const lights[4]) const {
+    getBatchLights(count, positions, normals, lights, true, true);
+}
+
+void LightEngine::getViewIndependentLights(size_t count, const float *const positions[3], const float *const normals[3], float *const lights[4]) const {
+    getBatchLights(count, positions, normals, lights, true, false);
+}
+
+void LightEngine::getSpecularLights(size_t count, const float *const positions[3], const float *const normals[3], float *const lights[4]) const {
+    getBatchLights(count, positions, normals, lights, false, true);
+}
+
+std::string LightEngine::getBatchInstructionSet() {
+    return batchInstructionSet;
+}
+
+void LightEngine::getBatchLights(size_t count, const float *const positions[3], const float *const normals[3], float *const lights[4],
+        bool viewIndependent, bool specular) const {
+    const lanes zero = broadcastLanes(0.0f);
+    const lanes one = broadcastLanes(1.0f);
+    const bool clamp = viewIndependent && specular;
+    std::vector<size_t> groupLights;
+
+    specular = specular && specularReflection.getLength() != 0.0;
+
+    for (size_t first = 0; first < count; first += laneCount) {
+        // The last group is padded with copies of its first point
+        const size_t groupSize = std::min(laneCount, count - first);
+        float groupValues[6][laneCount];
+
+        for (size_t i = 0; i < laneCount; ++i) {
+            const size_t point = first + (i < groupSize ? i : 0);
+
+            for (size_t j = 0; j < 3; ++j) {
+                groupValues[j][i] = positions[j][point];
+                groupValues[3 + j][i] = normals[j][point];
+            }
+        }
+
+        lanes position[3], normal[3], light[4];
+
+        for (size_t j = 0; j < 3; ++j) {
+            position[j] = loadLanes(groupValues[j]);
+            normal[j] = loadLanes(groupValues[3 + j]);
+        }
+
+        const lanes inverseNormalLength = inverseLengthLanes(normal[0], normal[1], normal[2]);
+        const lanes validNormal = inverseNormalLength > zero;
+
+        for (size_t j = 0; j < 3; ++j) {
+            normal[j] = normal[j] * inverseNormalLength;
+        }
+
+        for (size_t i = 0; i < 4; ++i) {
+            light[i] = broadcastLanes(viewIndependent ? ambientLight.intensity * ambientReflection.c(i) * ambientLight.color.c(i) : 0.0);
+        }
+
+        // Points of a group usually share a grid cell, otherwise the group visits the lights of all its cells
+        const size_t *cellLights = nullptr;
+        size_t cellLightCount = 0;
+        bool sharedCell = true;
+
+        for (size_t i = 0; i < groupSize; ++i) {
+            const size_t *pointLights;
+            size_t pointLightCount;
+            getCellLights(Vector4(positions[0][first + i], positions[1][first + i], positions[2][first + i]), pointLights, pointLightCount);
+
+            if (i == 0) {
+                cellLights = pointLights;
+                cellLightCount = pointLightCount;
+            } else if (pointLights != cellLights || pointLightCount != cellLightCount) {
+                if (sharedCell) {
+                    groupLights.assign(cellLights, cellLights + cellLightCount);
+                    sharedCell = false;
+                }
+
+                groupLights.insert(groupLights.end(), pointLights, pointLights + pointLightCount);
+            }
+        }
+
+        if (!sharedCell) {
+            std::sort(groupLights.begin(), groupLights.end());
+            groupLights.erase(std::unique(groupLights.begin(), groupLights.end()), groupLights.end());
+            cellLights = groupLights.data();
+            cellLightCount = groupLights.size();
+        }
+
+        lanes viewerDirection[3];
+
+        if (specular) {
+            for (size_t j = 0; j < 3; ++j) {
+                viewerDirection[j] = broadcastLanes(viewTranslation.c(j)) - position[j];
+            }
+
+            const lanes inverseViewerLength = inverseLengthLanes(viewerDirection[0], viewerDirection[1], viewerDirection[2]);
+
+            for (size_t j = 0; j < 3; ++j) {
+                viewerDirection[j] = viewerDirection[j] * inverseViewerLength;
+            }
+        }
+
+        for (size_t k = 0; k < globalLights.size() + cellLightCount; ++k) {
+            const size_t lightIndex = k < globalLights.size() ? globalLights[k] : cellLights[k - globalLights.size()];
+            const LightSource &lightSource = lightSources[lightIndex];
+            lanes lightDirection[3];
+
+            for (size_t j = 0; j < 3; ++j) {
+                lightDirection[j] = broadcastLanes(lightSource.position.c(j)) - position[j];
+            }
+
+            const lanes distance = sqrtLanes(
+                lightDirection[0] * lightDirection[0] +
+                lightDirection[1] * lightDirection[1] +
+                lightDirection[2] * lightDirection[2]);
+            const lanes reaching = validNormal & (distance <= broadcastLanes(std::min(lightRadiuses[lightIndex], Real(1e30))));
+
+            if (!anyLanes(reaching)) {
+                continue;
+            }
+
+            const lanes weight = broadcastLanes(lightSource.intensity) / (broadcastLanes(suppression) + distance);
+
+            if (viewIndependent) {
+                const lanes inverseDistance = selectLanes(distance > zero, one / maxLanes(distance, broadcastLanes(std::numeric_limits<float>::min())), zero);
+                const lanes cosDiffuseAngle = (
+                    normal[0] * lightDirection[0] +
+                    normal[1] * lightDirection[1] +
+                    normal[2] * lightDirection[2]) * inverseDistance;
+                const lanes diffuse = selectLanes(reaching & (cosDiffuseAngle > zero), weight * cosDiffuseAngle, zero);
+
+                for (size_t i = 0; i < 4; ++i) {
+                    light[i] = light[i] + diffuse * broadcastLanes(diffuseReflection.c(i) * lightSource.color.c(i));
+                }
+            }
+
+            if (specular) {
+                lanes reflectionDirection[3];
+
+                for (size_t j = 0; j < 3; ++j) {
+                    reflectionDirection[j] = lightDirection[j] - broadcastLanes(2.0f) * lightDirection[j] * normal[j] * normal[j];
+                }
+
+                const lanes cosSpecularAngle = (
+                    reflectionDirection[0] * viewerDirection[0] +
+                    reflectionDirection[1] * viewerDirection[1] +
+                    reflectionDirection[2] * viewerDirection[2]) *
+                    inverseLengthLanes(reflectionDirection[0], reflectionDirection[1], reflectionDirection[2]);
+                const lanes visible = reaching & (cosSpecularAngle > zero);
+
+                if (!anyLanes(visible)) {
+                    continue;
+                }
+
+                const lanes clampedCos = minLanes(maxLanes(cosSpecularAngle, broadcastLanes(std::numeric_limits<float>::min())), one);
+                const lanes power = exp2Lanes(broadcastLanes(shininess) * log2Lanes(clampedCos));
+                const lanes highlight = selectLanes(visible, weight * power, zero);
+
+                for (size_t i = 0; i < 4; ++i) {
+                    light[i] = light[i] + highlight * broadcastLanes(specularReflection.c(i));
+                }
+            }
+        }
+
+        for (size_t i = 0; i < 4; ++i) {
+            if (clamp) {
+                light[i] = minLanes(light[i], one);
+            }
+
+            storeLanes(groupValues[0], light[i]);
+            std::copy(groupValues[0], groupValues[0] + groupSize, lights[i] + first);
+        }
+    }
 }
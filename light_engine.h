@@ -1,6 +1,7 @@
 #ifndef LIGHT_ENGINE_H
 #define LIGHT_ENGINE_H
 
+#include <string>
 #include <vector>
 #include "light_source.h"
 
@@ -12,7 +13,7 @@ public:
 
     Vector4 getViewTranslation() const;
     void setViewTranslation(Vector4 viewTranslation);
-    void setViewTranslation(double x, double y, double z);
+    void setViewTranslation(Real x, Real y, Real z);
 
     void loadLightSourcesFromArray(const std::vector <LightSource> &lightSources, LightSource ambientLight = LightSource());
     bool loadLightSourcesFromBuffer(const std::string &buffer);
@@ -22,11 +23,42 @@ public:
         Vector4 ambientReflection = Vector4(1.0, 1.0, 1.0, 1.0),
         Vector4 diffuseReflection = Vector4(0.0, 0.0, 0.0, 1.0),
         Vector4 specularReflection = Vector4(0.0, 0.0, 0.0, 1.0),
-        double shininess = 1.0, double suppression = 1.0);
+        Real shininess = 1.0, Real suppression = 1.0);
     bool loadMaterialFromBuffer(const std::string &buffer);
     bool loadMaterialFromFile(const std::string &filePath);
 
+    // Reason the last load of light sources or material failed, naming the first bad line
+    const std::string& getLoadError() const;
+
+    // Lights are skipped where their contribution to every channel drops below the threshold,
+    // zero, the default, makes every light reach every point
+    Real getLightCullingThreshold() const;
+    void setLightCullingThreshold(Real lightCullingThreshold);
+
+    // Changes whenever light sources or material change
+    size_t getRevision() const;
+
     Vector4 getLight(Vector4 position, Vector4 normal) const;
+    Vector4 getViewIndependentLight(Vector4 position, Vector4 normal) const;
+    Vector4 getSpecularLight(Vector4 position, Vector4 normal) const;
+
+    // Batch versions of the functions above, positions and normals are passed as x, y and z arrays
+    // and lights are written as r, g, b and a arrays of count floats each. They run in single precision
+    // with a polynomial specular power, the relative error of which stays below about shininess * 1e-6
+    void getLights(size_t count, const float *const positions[3], const float *const normals[3], float *const lights[4]) const;
+    void getViewIndependentLights(size_t count, const float *const positions[3], const float *const normals[3], float *const lights[4]) const;
+    void getSpecularLights(size_t count, const float *const positions[3], const float *const normals[3], float *const lights[4]) const;
+
+    // Instruction set the batch functions were compiled for, AVX2, SSE2 or scalar
+    static std::string getBatchInstructionSet();
+
+private:
+
+    void buildLightGrid();
+    void getCellLights(Vector4 position, const size_t *&cellLights, size_t &cellLightCount) const;
+    const LightSource* getReachingLight(size_t i, const size_t *cellLights, Vector4 position, Real &distance) const;
+    void getBatchLights(size_t count, const float *const positions[3], const float *const normals[3], float *const lights[4],
+        bool viewIndependent, bool specular) const;
 
 private:
 
@@ -34,12 +66,25 @@ private:
     Vector4 ambientReflection;
     Vector4 diffuseReflection;
     Vector4 specularReflection;
-    double shininess;
-    double suppression;
+    Real shininess;
+    Real suppression;
+    size_t revision;
+    std::string loadError;
 
     LightSource ambientLight;
     std::vector <LightSource> lightSources;
 
+    // Lights with a finite radius are assigned to the cells of a uniform world space grid,
+    // the remaining ones reach every point
+    Real lightCullingThreshold;
+    std::vector<Real> lightRadiuses;
+    std::vector<size_t> globalLights;
+    Vector4 lightGridOrigin;
+    Real lightGridCellSize;
+    size_t lightGridSize[3];
+    std::vector<size_t> lightGridOffsets;
+    std::vector<size_t> lightGridLights;
+
 };
 
 #endif
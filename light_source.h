@@ -7,14 +7,14 @@ struct LightSource {
 
     LightSource() : LightSource(Vector4(), 1.0, Vector4(1.0, 1.0, 1.0, 1.0)) {}
 
-    LightSource(Vector4 position, double intensity, Vector4 color) {
+    LightSource(Vector4 position, Real intensity, Vector4 color) {
         this->position = position;
         this->intensity = intensity;
         this->color = color;
     }
 
     Vector4 position;
-    double intensity;
+    Real intensity;
     Vector4 color;
 };
 
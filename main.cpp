@@ -1,7 +1,10 @@
+#include <algorithm>
 #include <cmath>
 #include <iostream>
 #include <sstream>
 #include <SFML/Graphics.hpp>
+#include "frame_statistics.h"
+#include "model_streamer.h"
 #include "transform_engine.h"
 #include "render_engine.h"
 
@@ -16,15 +19,28 @@ const double rotationStep = PI / 12;
 const double fovyStep = PI / 12;
 const auto renderMode = RenderModes::Polygons;
 
-void displayTransformEngineStatistics(TransformEngine &transformEngine, sf::RenderWindow &window, sf::Font &font);
+// Light culling skips lights where they add less than one step of the 8-bit image
+const double lightCullingThreshold = 1.0 / 255;
+
+// Frames are drawn only when the view changes, the graph of their times marks the budget of a 60 Hz display
+const double frameTimeBudget = 1000.0 / 60;
+const float frameGraphHeight = 64.f;
+const float frameGraphPixelsPerMillisecond = 2.f;
+
+void displayStatistics(TransformEngine &transformEngine, RenderEngine &renderEngine, const FrameStatistics &frameStatistics,
+    const FrameTimeHistory &frameTimeHistory, sf::RenderWindow &window, sf::Font &font);
 std::string getImageFileName();
+std::string toString(FaceCullingModes faceCullingMode);
 double toDegrees(double radians);
-sf::VertexArray toVertexArray(const std::vector<Vertex>& vertexes);
-sf::Texture toTexture(const std::vector<Vector4>& image, size_t width, size_t height);
+sf::VertexArray toVertexArray(const std::vector<Vertex>& vertexes, const std::vector<size_t>& indexes);
+void updateTexture(sf::Texture &texture, const std::vector<uint8_t>& image, size_t width, size_t height);
 
 int main(int argc, char *argv[]) {
     TransformEngine transformEngine;
     RenderEngine renderEngine;
+    ModelStreamer modelStreamer;
+    FrameStatistics frameStatistics;
+    FrameTimeHistory frameTimeHistory;
     sf::VertexArray vertexArray;
     sf::Texture texture;
     sf::Font font;
@@ -34,18 +50,46 @@ int main(int argc, char *argv[]) {
     std::string fontFilePath = argc > 4 ? argv[4] : "assets/fonts/inconsolata.ttf";
     bool shouldDisplayStatistics = true;
 
-    if (!transformEngine.loadModelFromFile(modelFilePath)) {
-        std::cout << "Failed to load model \"" << modelFilePath << "\"" << std::endl;
-        return 1;
+    const bool isModelStreamed = renderMode == RenderModes::Polygons && ModelStreamer::isStreamedFile(modelFilePath);
+
+    if (isModelStreamed) {
+        if (!modelStreamer.open(modelFilePath)) {
+            std::cout << "Failed to load model \"" << modelFilePath << "\": " << modelStreamer.getLoadError() << std::endl;
+            return 1;
+        }
+
+        std::cout << "Streaming model in batches" << std::endl;
+    } else if (TransformEngine::isSceneFile(modelFilePath)) {
+        if (!transformEngine.loadSceneFromFile(modelFilePath)) {
+            std::cout << "Failed to load scene \"" << modelFilePath << "\": " << transformEngine.getLoadError() << std::endl;
+            return 1;
+        }
+
+        std::cout << "Loaded " << transformEngine.getMeshCount() << " meshes, " << transformEngine.getInstanceCount() <<
+            " instances" << std::endl;
+    } else {
+        if (!transformEngine.loadModelFromFile(modelFilePath)) {
+            std::cout << "Failed to load model \"" << modelFilePath << "\": " << transformEngine.getLoadError() << std::endl;
+            return 1;
+        }
+
+        if (transformEngine.getMeshCount() > 0) {
+            const Mesh &model = transformEngine.getMesh(0);
+
+            std::cout << "Loaded " << model.getSourceVertexCount() << " vertexes, " << model.getVertexCount() <<
+                " unique (" << model.getWeldRatio() << "x)" << std::endl;
+        }
     }
 
     if (!renderEngine.getLightEngine().loadMaterialFromFile(materialFilePath)) {
-        std::cout << "Failed to load material \"" << materialFilePath << "\"" << std::endl;
+        std::cout << "Failed to load material \"" << materialFilePath << "\": " <<
+            renderEngine.getLightEngine().getLoadError() << std::endl;
         return 2;
     }
 
     if (!renderEngine.getLightEngine().loadLightSourcesFromFile(lightSourcesFilePath)) {
-        std::cout << "Failed to load light sources \"" << lightSourcesFilePath << "\"" << std::endl;
+        std::cout << "Failed to load light sources \"" << lightSourcesFilePath << "\": " <<
+            renderEngine.getLightEngine().getLoadError() << std::endl;
         return 3;
     }
 
@@ -55,19 +99,36 @@ int main(int argc, char *argv[]) {
 
     // Moves camera to (0,0,-5). It will be pointed at (0,0,0), so keep in mind that X axis will be inverted.
     transformEngine.setViewTranslation(0, 0, 5);
-    transformEngine.run();
-    
-    renderEngine.setVertexArray(transformEngine.getTransformedVertexes());
     renderEngine.setViewSize(transformEngine.getViewWidth(), transformEngine.getViewHeight());
     renderEngine.getLightEngine().setViewTranslation(transformEngine.getViewTranslation());
-    renderEngine.run();
+
+    StageTimer frameTimer;
+
+    if (isModelStreamed) {
+        if (!modelStreamer.drawFrame(transformEngine, renderEngine, frameStatistics)) {
+            std::cout << "Failed to load model \"" << modelFilePath << "\": " << modelStreamer.getLoadError() << std::endl;
+            return 1;
+        }
+    } else {
+        transformEngine.run();
+        renderEngine.setVertexArray(transformEngine.getTransformedVertexes(), transformEngine.getTransformedIndexes());
+        renderEngine.run();
+        frameStatistics.addTransformStatistics(transformEngine);
+        frameStatistics.setRenderStatistics(renderEngine);
+    }
+
+    StageTimer presentTimer;
     
     if (renderMode == RenderModes::Polygons) {
-        vertexArray = toVertexArray(transformEngine.getTransformedVertexes());
+        updateTexture(texture, renderEngine.getImage(), renderEngine.getViewWidth(), renderEngine.getViewHeight());
     } else {
-        texture = toTexture(renderEngine.getImage(), renderEngine.getViewWidth(), renderEngine.getViewHeight());
+        vertexArray = toVertexArray(transformEngine.getTransformedVertexes(), transformEngine.getTransformedIndexes());
     }
 
+    frameStatistics.presentTime = presentTimer.getMilliseconds();
+    frameStatistics.frameTime = frameTimer.getMilliseconds();
+    frameTimeHistory.addFrameTime(frameStatistics.frameTime);
+
     sf::RenderWindow window(sf::VideoMode(transformEngine.getViewWidth(), transformEngine.getViewHeight()), "Computer Graphics");
     window.setFramerateLimit(60);
 
@@ -123,6 +184,32 @@ int main(int argc, char *argv[]) {
                         fovy = PI - fovyStep;
                     }
                     viewUpdated = true;
+                } else if (event.key.code == sf::Keyboard::R) {
+                    if (renderEngine.getRasterizationMode() == RasterizationModes::Scanline) {
+                        renderEngine.setRasterizationMode(RasterizationModes::HalfSpace);
+                    } else {
+                        renderEngine.setRasterizationMode(RasterizationModes::Scanline);
+                    }
+                    viewUpdated = true;
+                } else if (event.key.code == sf::Keyboard::C) {
+                    if (transformEngine.getFaceCullingMode() == FaceCullingModes::NoFaces) {
+                        transformEngine.setFaceCullingMode(FaceCullingModes::BackFaces);
+                    } else if (transformEngine.getFaceCullingMode() == FaceCullingModes::BackFaces) {
+                        transformEngine.setFaceCullingMode(FaceCullingModes::FrontFaces);
+                    } else {
+                        transformEngine.setFaceCullingMode(FaceCullingModes::NoFaces);
+                    }
+                    viewUpdated = true;
+                } else if (event.key.code == sf::Keyboard::F) {
+                    transformEngine.setFrustumCullingEnabled(!transformEngine.isFrustumCullingEnabled());
+                    viewUpdated = true;
+                } else if (event.key.code == sf::Keyboard::G) {
+                    LightEngine &lightEngine = renderEngine.getLightEngine();
+                    lightEngine.setLightCullingThreshold(lightEngine.getLightCullingThreshold() > 0 ? 0 : lightCullingThreshold);
+                    viewUpdated = true;
+                } else if (event.key.code == sf::Keyboard::L) {
+                    transformEngine.setLevelOfDetailEnabled(!transformEngine.isLevelOfDetailEnabled());
+                    viewUpdated = true;
                 } else if (event.key.code == sf::Keyboard::Z) {
                     shouldDisplayStatistics = !shouldDisplayStatistics;
                 } else if (event.key.code == sf::Keyboard::X) {
@@ -141,16 +228,36 @@ int main(int argc, char *argv[]) {
             }
         }
 
+        // A frame is timed from the first stage until it is presented, stages of the frame are a breakdown of it
         if (viewUpdated) {
+            frameTimer.restart();
+        }
+
+        if (viewUpdated && isModelStreamed) {
+            renderEngine.getLightEngine().setViewTranslation(transformEngine.getViewTranslation());
+
+            if (!modelStreamer.drawFrame(transformEngine, renderEngine, frameStatistics)) {
+                std::cout << "Failed to load model \"" << modelFilePath << "\": " << modelStreamer.getLoadError() << std::endl;
+                window.close();
+            }
+
+            presentTimer.restart();
+            updateTexture(texture, renderEngine.getImage(), renderEngine.getViewWidth(), renderEngine.getViewHeight());
+        } else if (viewUpdated) {
             transformEngine.run();
+            frameStatistics = FrameStatistics();
+            frameStatistics.addTransformStatistics(transformEngine);
 
             if (renderMode == RenderModes::Polygons) {
-                renderEngine.setVertexArray(transformEngine.getTransformedVertexes());
+                renderEngine.setVertexArray(transformEngine.getTransformedVertexes(), transformEngine.getTransformedIndexes());
                 renderEngine.getLightEngine().setViewTranslation(transformEngine.getViewTranslation());
                 renderEngine.run();
-                texture = toTexture(renderEngine.getImage(), renderEngine.getViewWidth(), renderEngine.getViewHeight());
+                frameStatistics.setRenderStatistics(renderEngine);
+                presentTimer.restart();
+                updateTexture(texture, renderEngine.getImage(), renderEngine.getViewWidth(), renderEngine.getViewHeight());
             } else {
-                vertexArray = toVertexArray(transformEngine.getTransformedVertexes());
+                presentTimer.restart();
+                vertexArray = toVertexArray(transformEngine.getTransformedVertexes(), transformEngine.getTransformedIndexes());
             }
         }
 
@@ -162,8 +269,15 @@ int main(int argc, char *argv[]) {
             window.draw(vertexArray);
         }
 
+        // Presenting ends before the statistics are drawn and before the display waits for the frame rate limit
+        if (viewUpdated) {
+            frameStatistics.presentTime = presentTimer.getMilliseconds();
+            frameStatistics.frameTime = frameTimer.getMilliseconds();
+            frameTimeHistory.addFrameTime(frameStatistics.frameTime);
+        }
+
         if (shouldDisplayStatistics) {
-            displayTransformEngineStatistics(transformEngine, window, font);
+            displayStatistics(transformEngine, renderEngine, frameStatistics, frameTimeHistory, window, font);
         }
         
         window.display();
@@ -172,7 +286,8 @@ int main(int argc, char *argv[]) {
     return 0;
 }
 
-void displayTransformEngineStatistics(TransformEngine &transformEngine, sf::RenderWindow &window, sf::Font &font) {
+void displayStatistics(TransformEngine &transformEngine, RenderEngine &renderEngine, const FrameStatistics &frameStatistics,
+        const FrameTimeHistory &frameTimeHistory, sf::RenderWindow &window, sf::Font &font) {
     std::stringstream stream;
     std::string buffer;
 
@@ -186,7 +301,39 @@ void displayTransformEngineStatistics(TransformEngine &transformEngine, sf::Rend
     stream << std::fixed
            << "Translation: " << translation.x() << ", " << translation.y() << ", " << translation.z() << std::endl
            << "Rotation: " << rotationDegress.x() << ", " << rotationDegress.y() << ", " << rotationDegress.z() << " degrees " << std::endl
-           << "Field of view: " << toDegrees(transformEngine.getFovy()) << " degrees";
+           << "Field of view: " << toDegrees(transformEngine.getFovy()) << " degrees" << std::endl
+           << "Face culling: " << toString(transformEngine.getFaceCullingMode()) << ", "
+           << transformEngine.getCulledTriangleCount() << " triangles culled" << std::endl
+           << "Frustum culling: " << (transformEngine.isFrustumCullingEnabled() ? "on" : "off") << ", "
+           << transformEngine.getCulledClusterCount() << " clusters culled" << std::endl
+           << "Level of detail: " << (transformEngine.isLevelOfDetailEnabled() ? "on" : "off") << ", "
+           << transformEngine.getSimplifiedInstanceCount() << " of " << transformEngine.getInstanceCount() << " instances simplified" << std::endl
+           << "Light culling: " << (renderEngine.getLightEngine().getLightCullingThreshold() > 0 ? "on" : "off") << std::endl
+           << "Rasterization: " << (renderEngine.getRasterizationMode() == RasterizationModes::Scanline ? "scanline" : "half-space");
+
+    if (renderEngine.getRasterizationMode() == RasterizationModes::HalfSpace) {
+        const auto& occlusionStatistics = renderEngine.getOcclusionStatistics();
+        stream << std::endl
+               << "Occlusion culled: " << occlusionStatistics.culledTriangleCount << " of " << occlusionStatistics.binnedTriangleCount
+               << " triangle tiles, " << occlusionStatistics.culledBlockCount << " blocks";
+    }
+
+    stream << std::endl
+           << "Frame: " << frameStatistics.frameTime << " ms, p50 " << frameTimeHistory.getPercentile(50) << ", p95 "
+           << frameTimeHistory.getPercentile(95) << ", p99 " << frameTimeHistory.getPercentile(99) << " ms of "
+           << frameTimeHistory.getFrameCount() << " frames" << std::endl
+           << "Stages: ";
+
+    // Only streamed models are read during the frame
+    if (frameStatistics.readTime > 0) {
+        stream << "read " << frameStatistics.readTime << ", ";
+    }
+
+    stream << "transform " << frameStatistics.transformTime << ", clip " << frameStatistics.clipTime << ", light "
+           << frameStatistics.lightTime << ", raster " << frameStatistics.rasterTime << ", shade " << frameStatistics.shadeTime
+           << ", present " << frameStatistics.presentTime << " ms" << std::endl
+           << "Work: " << frameStatistics.triangleCount << " triangles, " << frameStatistics.clippedTriangleCount << " clipped, "
+           << frameStatistics.fragmentCount << " fragments, " << frameStatistics.shadedPixelCount << " pixels shaded";
 
     sf::Text text;
     text.setFont(font);
@@ -203,6 +350,25 @@ void displayTransformEngineStatistics(TransformEngine &transformEngine, sf::Rend
 
         textPosition.y += lineSpacing;
     }
+
+    // Bars of the kept frame times from the oldest one, red where a frame missed the budget
+    const float graphBottom = textPosition.y + 4.f + frameGraphHeight;
+    sf::RectangleShape shape;
+
+    for (size_t i = 0; i < frameTimeHistory.getFrameCount(); ++i) {
+        const double frameTime = frameTimeHistory.getFrameTime(i);
+        const float barHeight = std::min(static_cast<float>(frameTime) * frameGraphPixelsPerMillisecond, frameGraphHeight);
+
+        shape.setSize(sf::Vector2f(2.f, barHeight));
+        shape.setPosition(4.f + 2.f * i, graphBottom - barHeight);
+        shape.setFillColor(frameTime <= frameTimeBudget ? sf::Color(64, 192, 64) : sf::Color(224, 64, 64));
+        window.draw(shape);
+    }
+
+    shape.setSize(sf::Vector2f(2.f * frameTimeHistory.getCapacity(), 1.f));
+    shape.setPosition(4.f, graphBottom - static_cast<float>(frameTimeBudget) * frameGraphPixelsPerMillisecond);
+    shape.setFillColor(sf::Color::White);
+    window.draw(shape);
 }
 
 std::string getImageFileName() {
@@ -211,6 +377,16 @@ std::string getImageFileName() {
     return "image_" + std::to_string(timestamp) + ".png";
 }
 
+std::string toString(FaceCullingModes faceCullingMode) {
+    if (faceCullingMode == FaceCullingModes::BackFaces) {
+        return "back faces";
+    } else if (faceCullingMode == FaceCullingModes::FrontFaces) {
+        return "front faces";
+    }
+
+    return "none";
+}
+
 double toDegrees(double radians) {
     double degrees = fmod(radians * 180 / PI, 360);
 
@@ -223,7 +399,7 @@ double toDegrees(double radians) {
     return degrees;
 }
 
-sf::VertexArray toVertexArray(const std::vector<Vertex>& vertexes) {
+sf::VertexArray toVertexArray(const std::vector<Vertex>& vertexes, const std::vector<size_t>& indexes) {
     sf::VertexArray vertexArray;
 
     if (renderMode == RenderModes::Points) {
@@ -236,10 +412,10 @@ sf::VertexArray toVertexArray(const std::vector<Vertex>& vertexes) {
         }
     } else if (renderMode == RenderModes::Lines) {
         vertexArray.setPrimitiveType(sf::PrimitiveType::Lines);
-        for (size_t i = 2; i < vertexes.size(); i = i + 3) {
+        for (size_t i = 2; i < indexes.size(); i = i + 3) {
             for (size_t j = 0; j < 3; ++j) {
-                const size_t va = (i-2) + j;
-                const size_t vb = (i-2) + (j+1) % 3;
+                const size_t va = indexes[(i-2) + j];
+                const size_t vb = indexes[(i-2) + (j+1) % 3];
                 vertexArray.append(sf::Vertex(sf::Vector2f(vertexes[va].position.cx(), vertexes[va].position.cy()),
                     sf::Color(vertexes[va].color.cx() * 255, vertexes[va].color.cy() * 255, vertexes[va].color.cz() * 255, vertexes[va].color.cw() * 255)));
                 vertexArray.append(sf::Vertex(sf::Vector2f(vertexes[vb].position.cx(), vertexes[vb].position.cy()),
@@ -251,20 +427,10 @@ sf::VertexArray toVertexArray(const std::vector<Vertex>& vertexes) {
     return vertexArray;
 }
 
-sf::Texture toTexture(const std::vector<Vector4>& image, size_t width, size_t height) {
-    sf::Image buffer;
-    sf::Texture texture;
-    
-    buffer.create(width, height);
-    
-    for (size_t y = 0; y < height; ++y) {
-        for (size_t x = 0; x < width; ++x) {
-            Vector4 pixel = image[y * width + x];
-            buffer.setPixel(x, y, sf::Color(pixel.cx() * 255, pixel.cy() * 255, pixel.cz() * 255, pixel.cw() * 255));
-        }
+void updateTexture(sf::Texture &texture, const std::vector<uint8_t>& image, size_t width, size_t height) {
+    if (texture.getSize().x != width || texture.getSize().y != height) {
+        texture.create(width, height);
     }
 
-    texture.loadFromImage(buffer);
-
-    return texture;
+    texture.update(image.data());
 }
@@ -0,0 +1,101 @@
+#include <fstream>
+#include "mapped_file.h"
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile() {
+    data = nullptr;
+    size = 0;
+    isMapped = false;
+}
+
+MappedFile::~MappedFile() {
+    close();
+}
+
+bool MappedFile::isMappingSupported() {
+#if defined(__unix__) || defined(__APPLE__)
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool MappedFile::open(const std::string &filePath) {
+    close();
+
+#if defined(__unix__) || defined(__APPLE__)
+    const int descriptor = ::open(filePath.c_str(), O_RDONLY);
+
+    if (descriptor < 0) {
+        return false;
+    }
+
+    struct stat status;
+
+    if (fstat(descriptor, &status) != 0) {
+        ::close(descriptor);
+        return false;
+    }
+
+    size = static_cast<size_t>(status.st_size);
+
+    // Empty files cannot be mapped, they are represented by an empty buffer
+    if (size == 0) {
+        ::close(descriptor);
+        data = buffer.data();
+        return true;
+    }
+
+    void *mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, descriptor, 0);
+    ::close(descriptor);
+
+    if (mapping == MAP_FAILED) {
+        size = 0;
+        return false;
+    }
+
+    data = static_cast<const char*>(mapping);
+    isMapped = true;
+
+    return true;
+#else
+    std::ifstream file(filePath, std::ios::binary);
+
+    if (!file.is_open()) {
+        return false;
+    }
+
+    buffer.assign(std::istreambuf_iterator<char>(file), {});
+    data = buffer.data();
+    size = buffer.size();
+
+    return true;
+#endif
+}
+
+void MappedFile::close() {
+#if defined(__unix__) || defined(__APPLE__)
+    if (isMapped) {
+        munmap(const_cast<char*>(data), size);
+    }
+#endif
+
+    buffer.clear();
+    buffer.shrink_to_fit();
+    data = nullptr;
+    size = 0;
+    isMapped = false;
+}
+
+const char* MappedFile::getData() const {
+    return data;
+}
+
+size_t MappedFile::getSize() const {
+    return size;
+}
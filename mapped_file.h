@@ -0,0 +1,36 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <string>
+#include <vector>
+
+// Read only view of a whole file, memory mapped where the platform supports it and read into memory elsewhere
+class MappedFile {
+
+public:
+
+    MappedFile();
+    ~MappedFile();
+
+    MappedFile(const MappedFile &other) = delete;
+    MappedFile& operator=(const MappedFile &other) = delete;
+
+    // False where open reads the whole file into memory instead of mapping it
+    static bool isMappingSupported();
+
+    bool open(const std::string &filePath);
+    void close();
+
+    const char* getData() const;
+    size_t getSize() const;
+
+private:
+
+    const char *data;
+    size_t size;
+    bool isMapped;
+    std::vector<char> buffer;
+
+};
+
+#endif
@@ -1,51 +1,182 @@
+#include <algorithm>
 #include <sstream>
 #include <iomanip>
 #include "matrix4x4.h"
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
-Matrix4x4::Matrix4x4() {
+template <typename T>
+BasicMatrix4x4<T>::BasicMatrix4x4() {
     for (size_t i = 0; i < 16; ++i) {
         data[i] = 0;
     }
 }
 
-Matrix4x4 Matrix4x4::operator*(const Matrix4x4 &other) const { 
-    Matrix4x4 result;
+template <typename T>
+BasicMatrix4x4<T> BasicMatrix4x4<T>::operator*(const BasicMatrix4x4 &other) const { 
+    BasicMatrix4x4 result;
+
+    // Row i of the product combines the rows of the other matrix with the entries of row i
+    combineColumns(other.data, data, result.data, 4);
+
+    return result; 
+}
+
+template <typename T>
+BasicVector4<T> BasicMatrix4x4<T>::operator*(const BasicVector4<T> &other) const {
+    BasicVector4<T> result;
+
+    transformBatch(&other, &result, 1);
+
+    return result;
+}
+
+template <typename T>
+void BasicMatrix4x4<T>::transformBatch(const BasicVector4<T> *input, BasicVector4<T> *output, size_t count) const {
+    static_assert(sizeof(BasicVector4<T>) == 4 * sizeof(T), "vectors must be tightly packed");
+
+    T columns[16];
 
     for (size_t i = 0; i < 4; ++i) {
         for (size_t j = 0; j < 4; ++j) {
-            double sum = 0;
-            for(size_t k = 0; k < 4; ++k) {
-                sum += get(i, k) * other.get(k, j);
-            }
-            result.set(i, j, sum);
+            columns[4 * j + i] = data[4 * i + j];
         }
     }
 
-    return result; 
+    combineColumns(columns, reinterpret_cast<const T*>(input), reinterpret_cast<T*>(output), count);
 }
 
-Vector4 Matrix4x4::operator*(const Vector4 &other) const {
-    Vector4 result;
+template <typename T>
+void BasicMatrix4x4<T>::combineColumns(const T *columns, const T *input, T *output, size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+        const T *vector = input + 4 * i;
+        T result[4];
 
-    for (size_t i = 0; i < 4; ++i) {
-        result[i] = 0;
-        for (size_t j = 0; j < 4; ++j) {
-            result[i] += get(i, j) * other.c(j);
+        for (size_t k = 0; k < 4; ++k) {
+            result[k] = columns[k] * vector[0];
+        }
+
+        for (size_t j = 1; j < 4; ++j) {
+            for (size_t k = 0; k < 4; ++k) {
+                result[k] += columns[4 * j + k] * vector[j];
+            }
         }
+
+        std::copy(result, result + 4, output + 4 * i);
     }
+}
 
-    return result;
+#if defined(__AVX__)
+// Two float vectors at a time, one in each half of the register
+template <>
+void BasicMatrix4x4<float>::combineColumns(const float *columns, const float *input, float *output, size_t count) {
+    __m256 wideColumns[4];
+    size_t i = 0;
+
+    for (size_t j = 0; j < 4; ++j) {
+        wideColumns[j] = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(columns + 4 * j));
+    }
+
+    for (; i + 2 <= count; i += 2) {
+        const __m256 vectors = _mm256_loadu_ps(input + 4 * i);
+        __m256 result = _mm256_mul_ps(wideColumns[0], _mm256_shuffle_ps(vectors, vectors, 0x00));
+        result = _mm256_add_ps(result, _mm256_mul_ps(wideColumns[1], _mm256_shuffle_ps(vectors, vectors, 0x55)));
+        result = _mm256_add_ps(result, _mm256_mul_ps(wideColumns[2], _mm256_shuffle_ps(vectors, vectors, 0xaa)));
+        result = _mm256_add_ps(result, _mm256_mul_ps(wideColumns[3], _mm256_shuffle_ps(vectors, vectors, 0xff)));
+        _mm256_storeu_ps(output + 4 * i, result);
+    }
+
+    for (; i < count; ++i) {
+        const __m128 vector = _mm_loadu_ps(input + 4 * i);
+        __m128 result = _mm_mul_ps(_mm256_castps256_ps128(wideColumns[0]), _mm_shuffle_ps(vector, vector, 0x00));
+        result = _mm_add_ps(result, _mm_mul_ps(_mm256_castps256_ps128(wideColumns[1]), _mm_shuffle_ps(vector, vector, 0x55)));
+        result = _mm_add_ps(result, _mm_mul_ps(_mm256_castps256_ps128(wideColumns[2]), _mm_shuffle_ps(vector, vector, 0xaa)));
+        result = _mm_add_ps(result, _mm_mul_ps(_mm256_castps256_ps128(wideColumns[3]), _mm_shuffle_ps(vector, vector, 0xff)));
+        _mm_storeu_ps(output + 4 * i, result);
+    }
+}
+
+// One double vector at a time
+template <>
+void BasicMatrix4x4<double>::combineColumns(const double *columns, const double *input, double *output, size_t count) {
+    __m256d wideColumns[4];
+
+    for (size_t j = 0; j < 4; ++j) {
+        wideColumns[j] = _mm256_loadu_pd(columns + 4 * j);
+    }
+
+    for (size_t i = 0; i < count; ++i) {
+        const double *vector = input + 4 * i;
+        __m256d result = _mm256_mul_pd(wideColumns[0], _mm256_broadcast_sd(vector));
+        result = _mm256_add_pd(result, _mm256_mul_pd(wideColumns[1], _mm256_broadcast_sd(vector + 1)));
+        result = _mm256_add_pd(result, _mm256_mul_pd(wideColumns[2], _mm256_broadcast_sd(vector + 2)));
+        result = _mm256_add_pd(result, _mm256_mul_pd(wideColumns[3], _mm256_broadcast_sd(vector + 3)));
+        _mm256_storeu_pd(output + 4 * i, result);
+    }
+}
+#elif defined(__SSE2__)
+// One float vector at a time
+template <>
+void BasicMatrix4x4<float>::combineColumns(const float *columns, const float *input, float *output, size_t count) {
+    __m128 wideColumns[4];
+
+    for (size_t j = 0; j < 4; ++j) {
+        wideColumns[j] = _mm_loadu_ps(columns + 4 * j);
+    }
+
+    for (size_t i = 0; i < count; ++i) {
+        const __m128 vector = _mm_loadu_ps(input + 4 * i);
+        __m128 result = _mm_mul_ps(wideColumns[0], _mm_shuffle_ps(vector, vector, 0x00));
+        result = _mm_add_ps(result, _mm_mul_ps(wideColumns[1], _mm_shuffle_ps(vector, vector, 0x55)));
+        result = _mm_add_ps(result, _mm_mul_ps(wideColumns[2], _mm_shuffle_ps(vector, vector, 0xaa)));
+        result = _mm_add_ps(result, _mm_mul_ps(wideColumns[3], _mm_shuffle_ps(vector, vector, 0xff)));
+        _mm_storeu_ps(output + 4 * i, result);
+    }
+}
+
+// One double vector at a time, split into the x, y and the z, w halves
+template <>
+void BasicMatrix4x4<double>::combineColumns(const double *columns, const double *input, double *output, size_t count) {
+    __m128d lowColumns[4], highColumns[4];
+
+    for (size_t j = 0; j < 4; ++j) {
+        lowColumns[j] = _mm_loadu_pd(columns + 4 * j);
+        highColumns[j] = _mm_loadu_pd(columns + 4 * j + 2);
+    }
+
+    for (size_t i = 0; i < count; ++i) {
+        const double *vector = input + 4 * i;
+        __m128d value = _mm_load1_pd(vector);
+        __m128d low = _mm_mul_pd(lowColumns[0], value);
+        __m128d high = _mm_mul_pd(highColumns[0], value);
+
+        for (size_t j = 1; j < 4; ++j) {
+            value = _mm_load1_pd(vector + j);
+            low = _mm_add_pd(low, _mm_mul_pd(lowColumns[j], value));
+            high = _mm_add_pd(high, _mm_mul_pd(highColumns[j], value));
+        }
+
+        _mm_storeu_pd(output + 4 * i, low);
+        _mm_storeu_pd(output + 4 * i + 2, high);
+    }
 }
+#endif
 
-double Matrix4x4::get(size_t row, size_t column) const {
+template <typename T>
+T BasicMatrix4x4<T>::get(size_t row, size_t column) const {
     return data[row * 4 + column];
 }
 
-void Matrix4x4::set(size_t row, size_t column, double value) {
+template <typename T>
+void BasicMatrix4x4<T>::set(size_t row, size_t column, T value) {
     data[row * 4 + column] = value;
 }
 
-std::string Matrix4x4::toString() const {
+template <typename T>
+std::string BasicMatrix4x4<T>::toString() const {
     std::ostringstream stream;
 
     for (size_t i = 0; i < 4; ++i) {
@@ -57,3 +188,6 @@ std::string Matrix4x4::toString() const {
 
     return stream.str();
 }
+
+template class BasicMatrix4x4<float>;
+template class BasicMatrix4x4<double>;
@@ -4,24 +4,36 @@
 #include <string>
 #include "vector4.h"
 
-class Matrix4x4 {
+// Defined for float and double only
+template <typename T>
+class BasicMatrix4x4 {
 
 public:
 
-    Matrix4x4();
+    BasicMatrix4x4();
 
-    Matrix4x4 operator*(const Matrix4x4 &other) const;
-    Vector4 operator*(const Vector4 &other) const;
+    BasicMatrix4x4 operator*(const BasicMatrix4x4 &other) const;
+    BasicVector4<T> operator*(const BasicVector4<T> &other) const;
 
-    double get(size_t row, size_t column) const;
-    void set(size_t row, size_t column, double value);
+    // Multiplies count vectors by the matrix with SSE or AVX where available, input may equal output
+    void transformBatch(const BasicVector4<T> *input, BasicVector4<T> *output, size_t count) const;
+
+    T get(size_t row, size_t column) const;
+    void set(size_t row, size_t column, T value);
 
     std::string toString() const;
 
 private:
 
-    double data[16];
+    // Writes the sum of the four columns weighted by the coordinates of each input vector
+    static void combineColumns(const T *columns, const T *input, T *output, size_t count);
+
+private:
+
+    T data[16];
     
 };
 
+typedef BasicMatrix4x4<Real> Matrix4x4;
+
 #endif
@@ -0,0 +1,247 @@
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <unordered_map>
+#include "mesh.h"
+
+// Binary mesh layout: the header followed by the position, vertex and index arrays, each starting
+// at a multiple of binaryMeshAlignment. The arrays are stored exactly as they are kept in memory.
+const char binaryMeshMagic[8] = { 'C', 'G', 'M', 'E', 'S', 'H', 0, 0 };
+const uint32_t binaryMeshVersion = 1;
+const uint32_t binaryMeshByteOrder = 0x01020304;
+const uint64_t binaryMeshAlignment = 64;
+
+struct binaryMeshHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t byteOrder;
+    uint32_t scalarSize;
+    uint32_t vertexSize;
+    uint32_t indexSize;
+    uint32_t reserved;
+    uint64_t vertexCount;
+    uint64_t indexCount;
+    uint64_t sourceVertexCount;
+    uint64_t positionOffset;
+    uint64_t vertexOffset;
+    uint64_t indexOffset;
+};
+
+uint64_t alignBinaryMeshOffset(uint64_t offset) {
+    return (offset + binaryMeshAlignment - 1) / binaryMeshAlignment * binaryMeshAlignment;
+}
+
+// Checks that count elements of the given size fit in the file at offset
+bool isBinaryMeshArrayValid(uint64_t offset, uint64_t count, uint64_t size, uint64_t fileSize) {
+    return offset % binaryMeshAlignment == 0 && offset <= fileSize && count <= (fileSize - offset) / size;
+}
+
+struct vertexKey {
+    const Vertex *vertex;
+
+    bool operator==(const vertexKey &other) const {
+        return vertex->origin == other.vertex->origin && vertex->position == other.vertex->position &&
+            vertex->color == other.vertex->color && vertex->normal == other.vertex->normal;
+    }
+};
+
+struct vertexKeyHash {
+    size_t operator()(const vertexKey &key) const {
+        const Vector4 *attributes[] = { &key.vertex->origin, &key.vertex->position, &key.vertex->color, &key.vertex->normal };
+        size_t hash = 0;
+
+        for (const Vector4 *attribute : attributes) {
+            for (size_t i = 0; i < 4; ++i) {
+                // Adding zero turns -0 into 0, the two compare equal so they must hash equal
+                hash = hash * 31 + std::hash<Real>()(attribute->c(i) + Real(0));
+            }
+        }
+
+        return hash;
+    }
+};
+
+Mesh::Mesh() {
+    clear();
+}
+
+void Mesh::loadFromVertexArray(const std::vector<Vertex> &vertexArray) {
+    const size_t indexCount = vertexArray.size() - vertexArray.size() % 3;
+    std::unordered_map<vertexKey, size_t, vertexKeyHash> uniqueIndexes(indexCount);
+
+    clear();
+    indexBuffer.reserve(indexCount);
+
+    for (size_t i = 0; i < indexCount; ++i) {
+        auto inserted = uniqueIndexes.insert(std::make_pair(vertexKey{ &vertexArray[i] }, vertexBuffer.size()));
+
+        if (inserted.second) {
+            vertexBuffer.push_back(vertexArray[i]);
+            vertexBuffer.back().index = inserted.first->second;
+            positionBuffer.push_back(vertexArray[i].position);
+        }
+
+        indexBuffer.push_back(inserted.first->second);
+    }
+
+    setArrays(vertexBuffer.data(), positionBuffer.data(), vertexBuffer.size(), indexBuffer.data(), indexBuffer.size());
+    sourceVertexCount = indexCount;
+}
+
+bool Mesh::loadFromBinaryFile(const std::string &filePath) {
+    std::unique_ptr<MappedFile> file(new MappedFile());
+    binaryMeshHeader header;
+
+    clear();
+
+    if (!file->open(filePath)) {
+        loadError = "cannot open the file";
+        return false;
+    }
+
+    if (file->getSize() < sizeof(header)) {
+        loadError = "the binary mesh is truncated";
+        return false;
+    }
+
+    std::memcpy(&header, file->getData(), sizeof(header));
+
+    if (std::memcmp(header.magic, binaryMeshMagic, sizeof(binaryMeshMagic)) != 0 || header.version != binaryMeshVersion) {
+        loadError = "the binary mesh has an unsupported version";
+        return false;
+    }
+
+    if (header.byteOrder != binaryMeshByteOrder || header.scalarSize != sizeof(Real) ||
+        header.vertexSize != sizeof(Vertex) || header.indexSize != sizeof(size_t)) {
+        loadError = "the binary mesh was saved with a different precision or layout, convert it again";
+        return false;
+    }
+
+    if (header.indexCount % 3 != 0 || header.sourceVertexCount < header.vertexCount ||
+        !isBinaryMeshArrayValid(header.positionOffset, header.vertexCount, sizeof(Vector4), file->getSize()) ||
+        !isBinaryMeshArrayValid(header.vertexOffset, header.vertexCount, sizeof(Vertex), file->getSize()) ||
+        !isBinaryMeshArrayValid(header.indexOffset, header.indexCount, sizeof(size_t), file->getSize())) {
+        loadError = "the binary mesh is truncated or damaged";
+        return false;
+    }
+
+    // Indexes are read once, so that a damaged file cannot make the engine read past the vertexes later
+    const size_t *indexes = reinterpret_cast<const size_t*>(file->getData() + header.indexOffset);
+
+    for (size_t i = 0; i < header.indexCount; ++i) {
+        if (indexes[i] >= header.vertexCount) {
+            loadError = "the binary mesh has an index past its vertexes";
+            return false;
+        }
+    }
+
+    setArrays(reinterpret_cast<const Vertex*>(file->getData() + header.vertexOffset),
+        reinterpret_cast<const Vector4*>(file->getData() + header.positionOffset), header.vertexCount,
+        indexes, header.indexCount);
+    sourceVertexCount = header.sourceVertexCount;
+    mappedFile = std::move(file);
+
+    return true;
+}
+
+bool Mesh::saveToBinaryFile(const std::string &filePath) const {
+    std::ofstream file(filePath, std::ios::binary);
+    binaryMeshHeader header;
+
+    if (!file.is_open()) {
+        return false;
+    }
+
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, binaryMeshMagic, sizeof(binaryMeshMagic));
+    header.version = binaryMeshVersion;
+    header.byteOrder = binaryMeshByteOrder;
+    header.scalarSize = sizeof(Real);
+    header.vertexSize = sizeof(Vertex);
+    header.indexSize = sizeof(size_t);
+    header.vertexCount = vertexCount;
+    header.indexCount = indexCount;
+    header.sourceVertexCount = sourceVertexCount;
+    header.positionOffset = alignBinaryMeshOffset(sizeof(header));
+    header.vertexOffset = alignBinaryMeshOffset(header.positionOffset + vertexCount * sizeof(Vector4));
+    header.indexOffset = alignBinaryMeshOffset(header.vertexOffset + vertexCount * sizeof(Vertex));
+
+    const char padding[binaryMeshAlignment] = {};
+    const uint64_t offsets[] = { header.positionOffset, header.vertexOffset, header.indexOffset };
+    const char *arrays[] = { reinterpret_cast<const char*>(positions), reinterpret_cast<const char*>(vertexes),
+        reinterpret_cast<const char*>(indexes) };
+    const uint64_t sizes[] = { vertexCount * sizeof(Vector4), vertexCount * sizeof(Vertex), indexCount * sizeof(size_t) };
+    uint64_t offset = sizeof(header);
+
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+    for (size_t i = 0; i < 3; ++i) {
+        file.write(padding, offsets[i] - offset);
+        file.write(arrays[i], sizes[i]);
+        offset = offsets[i] + sizes[i];
+    }
+
+    return file.good();
+}
+
+bool Mesh::isBinaryFile(const std::string &filePath) {
+    std::ifstream file(filePath, std::ios::binary);
+    char magic[sizeof(binaryMeshMagic)];
+
+    return file.read(magic, sizeof(magic)) && std::memcmp(magic, binaryMeshMagic, sizeof(magic)) == 0;
+}
+
+const std::string& Mesh::getLoadError() const {
+    return loadError;
+}
+
+void Mesh::clear() {
+    vertexBuffer.clear();
+    positionBuffer.clear();
+    indexBuffer.clear();
+    mappedFile.reset();
+    setArrays(nullptr, nullptr, 0, nullptr, 0);
+    sourceVertexCount = 0;
+    loadError.clear();
+}
+
+const Vertex* Mesh::getVertexes() const {
+    return vertexes;
+}
+
+size_t Mesh::getVertexCount() const {
+    return vertexCount;
+}
+
+const size_t* Mesh::getIndexes() const {
+    return indexes;
+}
+
+size_t Mesh::getIndexCount() const {
+    return indexCount;
+}
+
+size_t Mesh::getTriangleCount() const {
+    return indexCount / 3;
+}
+
+const Vector4* Mesh::getPositions() const {
+    return positions;
+}
+
+size_t Mesh::getSourceVertexCount() const {
+    return sourceVertexCount;
+}
+
+double Mesh::getWeldRatio() const {
+    return vertexCount == 0 ? 1.0 : static_cast<double>(sourceVertexCount) / vertexCount;
+}
+
+void Mesh::setArrays(const Vertex *vertexes, const Vector4 *positions, size_t vertexCount, const size_t *indexes, size_t indexCount) {
+    this->vertexes = vertexes;
+    this->positions = positions;
+    this->vertexCount = vertexCount;
+    this->indexes = indexes;
+    this->indexCount = indexCount;
+}
@@ -0,0 +1,65 @@
+#ifndef MESH_H
+#define MESH_H
+
+#include <memory>
+#include <string>
+#include <vector>
+#include "mapped_file.h"
+#include "vertex.h"
+
+// Indexed triangle list, every 3 consecutive indexes form a triangle
+class Mesh {
+
+public:
+
+    Mesh();
+
+    // Welds vertexes equal in every attribute, every 3 consecutive vertexes of the array form a triangle.
+    // Vertexes get their index in the unique vertex buffer.
+    void loadFromVertexArray(const std::vector<Vertex> &vertexArray);
+
+    // Binary meshes keep the arrays in the native layout of the engine, so they are mapped and used
+    // in place. They only load into an engine of the same precision and index size as the saving one.
+    bool loadFromBinaryFile(const std::string &filePath);
+    bool saveToBinaryFile(const std::string &filePath) const;
+    static bool isBinaryFile(const std::string &filePath);
+    const std::string& getLoadError() const;
+
+    void clear();
+
+    const Vertex* getVertexes() const;
+    size_t getVertexCount() const;
+    const size_t* getIndexes() const;
+    size_t getIndexCount() const;
+    size_t getTriangleCount() const;
+
+    // Vertex positions kept contiguous, so that they can be transformed in batches
+    const Vector4* getPositions() const;
+
+    // Vertex count before welding and its ratio to the unique vertex count
+    size_t getSourceVertexCount() const;
+    double getWeldRatio() const;
+
+private:
+
+    void setArrays(const Vertex *vertexes, const Vector4 *positions, size_t vertexCount, const size_t *indexes, size_t indexCount);
+
+private:
+
+    // Arrays point either to the owned vectors or into the mapped file
+    const Vertex *vertexes;
+    const Vector4 *positions;
+    const size_t *indexes;
+    size_t vertexCount;
+    size_t indexCount;
+    size_t sourceVertexCount;
+    std::string loadError;
+
+    std::vector<Vertex> vertexBuffer;
+    std::vector<Vector4> positionBuffer;
+    std::vector<size_t> indexBuffer;
+    std::unique_ptr<MappedFile> mappedFile;
+
+};
+
+#endif
@@ -0,0 +1,269 @@
+#include <algorithm>
+#include <cmath>
+#include <unordered_map>
+#include <unordered_set>
+#include "mesh_simplifier.h"
+
+// Cell coordinates are packed into one key with this many bits each
+const unsigned cellCoordinateBits = 21;
+const uint64_t cellCoordinateMask = (uint64_t(1) << cellCoordinateBits) - 1;
+
+// Quadrics whose determinant is this small relative to the cube of their trace constrain the position along fewer
+// than three directions, which happens on flat surfaces and along edges, so the mean position is used instead
+const double singularQuadricScale = 1e-6;
+
+// Triangle of representatives, rotated so that the smallest one comes first without changing the winding
+struct triangleKey {
+    size_t representatives[3];
+
+    bool operator==(const triangleKey &other) const {
+        return representatives[0] == other.representatives[0] && representatives[1] == other.representatives[1] &&
+            representatives[2] == other.representatives[2];
+    }
+};
+
+struct triangleKeyHash {
+    size_t operator()(const triangleKey &key) const {
+        return (key.representatives[0] * 31 + key.representatives[1]) * 31 + key.representatives[2];
+    }
+};
+
+MeshSimplifier::MeshSimplifier() {
+    maximumDisplacement = 0;
+}
+
+bool MeshSimplifier::simplify(const Mesh &mesh, Real cellSize, Mesh &simplifiedMesh) {
+    const Vector4 *positions = mesh.getPositions();
+    const Vertex *vertexes = mesh.getVertexes();
+    const size_t *indexes = mesh.getIndexes();
+    const size_t vertexCount = mesh.getVertexCount();
+    Real minimum[3], maximum[3];
+
+    maximumDisplacement = 0;
+
+    if (vertexCount == 0 || !(cellSize > 0)) {
+        return false;
+    }
+
+    for (size_t j = 0; j < 3; ++j) {
+        minimum[j] = maximum[j] = positions[0].c(j);
+    }
+
+    for (size_t i = 0; i < vertexCount; ++i) {
+        for (size_t j = 0; j < 3; ++j) {
+            if (!std::isfinite(positions[i].c(j))) {
+                return false;
+            }
+
+            minimum[j] = std::min(minimum[j], positions[i].c(j));
+            maximum[j] = std::max(maximum[j], positions[i].c(j));
+        }
+    }
+
+    for (size_t j = 0; j < 3; ++j) {
+        if ((maximum[j] - minimum[j]) / cellSize >= cellCoordinateMask) {
+            return false;
+        }
+    }
+
+    gridOrigin = Vector4(minimum[0], minimum[1], minimum[2], 1);
+    vertexCells.resize(vertexCount);
+    vertexRepresentatives.resize(vertexCount);
+    cellCoordinates.clear();
+    cellQuadrics.clear();
+    cellPositionSums.clear();
+    cellVertexCounts.clear();
+    cellRepresentatives.clear();
+    representatives.clear();
+
+    // Vertexes are put into cells, and into representatives of their color within the cell
+    std::unordered_map<uint64_t, size_t> cells(vertexCount);
+
+    for (size_t i = 0; i < vertexCount; ++i) {
+        uint64_t key = 0;
+
+        for (size_t j = 0; j < 3; ++j) {
+            const uint64_t coordinate = static_cast<uint64_t>((positions[i].c(j) - minimum[j]) / cellSize);
+            key |= std::min(coordinate, cellCoordinateMask) << (cellCoordinateBits * j);
+        }
+
+        auto inserted = cells.insert(std::make_pair(key, cellCoordinates.size()));
+        const size_t cell = inserted.first->second;
+
+        if (inserted.second) {
+            cellCoordinates.push_back(key);
+            cellQuadrics.push_back(quadric());
+            cellPositionSums.push_back(Vector4());
+            cellVertexCounts.push_back(0);
+            cellRepresentatives.push_back(SIZE_MAX);
+        }
+
+        for (size_t j = 0; j < 3; ++j) {
+            cellPositionSums[cell][j] += positions[i].c(j);
+        }
+
+        ++cellVertexCounts[cell];
+        vertexCells[i] = cell;
+
+        size_t match = cellRepresentatives[cell];
+
+        while (match != SIZE_MAX && representatives[match].color != vertexes[i].color) {
+            match = representatives[match].next;
+        }
+
+        if (match == SIZE_MAX) {
+            match = representatives.size();
+            representatives.push_back(representative{ cell, cellRepresentatives[cell], vertexes[i].color, Vector4(), 0 });
+            cellRepresentatives[cell] = match;
+        }
+
+        for (size_t j = 0; j < 4; ++j) {
+            representatives[match].normal[j] += vertexes[i].normal.c(j);
+        }
+
+        ++representatives[match].vertexCount;
+        vertexRepresentatives[i] = match;
+    }
+
+    // Every cell gets the quadrics of the triangles around its vertexes
+    for (size_t i = 0; i < mesh.getIndexCount(); i = i + 3) {
+        const Vector4 &a = positions[indexes[i]];
+        const Vector4 &b = positions[indexes[i+1]];
+        const Vector4 &c = positions[indexes[i+2]];
+        const double ab[3] = { double(b.cx()) - a.cx(), double(b.cy()) - a.cy(), double(b.cz()) - a.cz() };
+        const double ac[3] = { double(c.cx()) - a.cx(), double(c.cy()) - a.cy(), double(c.cz()) - a.cz() };
+        double normal[3] = { ab[1] * ac[2] - ab[2] * ac[1], ab[2] * ac[0] - ab[0] * ac[2], ab[0] * ac[1] - ab[1] * ac[0] };
+        const double length = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+
+        if (length == 0) {
+            continue;
+        }
+
+        for (size_t j = 0; j < 3; ++j) {
+            normal[j] /= length;
+        }
+
+        const double d = -(normal[0] * a.cx() + normal[1] * a.cy() + normal[2] * a.cz());
+        const double weight = length / 2;
+        const size_t triangleCells[3] = { vertexCells[indexes[i]], vertexCells[indexes[i+1]], vertexCells[indexes[i+2]] };
+
+        for (size_t k = 0; k < 3; ++k) {
+            if ((k > 0 && triangleCells[k] == triangleCells[0]) || (k > 1 && triangleCells[k] == triangleCells[1])) {
+                continue;
+            }
+
+            quadric &q = cellQuadrics[triangleCells[k]];
+
+            q.a[0] += weight * normal[0] * normal[0];
+            q.a[1] += weight * normal[0] * normal[1];
+            q.a[2] += weight * normal[0] * normal[2];
+            q.a[3] += weight * normal[1] * normal[1];
+            q.a[4] += weight * normal[1] * normal[2];
+            q.a[5] += weight * normal[2] * normal[2];
+
+            for (size_t j = 0; j < 3; ++j) {
+                q.b[j] += weight * normal[j] * d;
+            }
+        }
+    }
+
+    cellPositions.resize(cellCoordinates.size());
+
+    for (size_t cell = 0; cell < cellCoordinates.size(); ++cell) {
+        cellPositions[cell] = getCellPosition(cell, cellSize);
+    }
+
+    for (size_t i = 0; i < vertexCount; ++i) {
+        const Vector4 &cellPosition = cellPositions[vertexCells[i]];
+        const Vector4 offset(cellPosition.cx() - positions[i].cx(), cellPosition.cy() - positions[i].cy(),
+            cellPosition.cz() - positions[i].cz());
+
+        maximumDisplacement = std::max(maximumDisplacement, offset.getLength());
+    }
+
+    // Triangles with two vertexes in one cell collapse, the same triangle left more than once is kept once
+    std::unordered_set<triangleKey, triangleKeyHash> triangles;
+    std::vector<Vertex> vertexArray;
+
+    for (size_t i = 0; i < mesh.getIndexCount(); i = i + 3) {
+        const size_t a = vertexRepresentatives[indexes[i]];
+        const size_t b = vertexRepresentatives[indexes[i+1]];
+        const size_t c = vertexRepresentatives[indexes[i+2]];
+
+        if (representatives[a].cell == representatives[b].cell || representatives[b].cell == representatives[c].cell ||
+                representatives[a].cell == representatives[c].cell) {
+            continue;
+        }
+
+        triangleKey key = { { a, b, c } };
+
+        while (key.representatives[0] != std::min(std::min(a, b), c)) {
+            std::rotate(key.representatives, key.representatives + 1, key.representatives + 3);
+        }
+
+        if (!triangles.insert(key).second) {
+            continue;
+        }
+
+        for (const size_t r : key.representatives) {
+            Vertex vertex;
+
+            vertex.position = cellPositions[representatives[r].cell];
+            vertex.origin = vertex.position;
+            vertex.color = representatives[r].color;
+
+            for (size_t j = 0; j < 4; ++j) {
+                vertex.normal[j] = representatives[r].normal.c(j) / representatives[r].vertexCount;
+            }
+
+            vertexArray.push_back(vertex);
+        }
+    }
+
+    simplifiedMesh.loadFromVertexArray(vertexArray);
+
+    return true;
+}
+
+Real MeshSimplifier::getMaximumDisplacement() const {
+    return maximumDisplacement;
+}
+
+Vector4 MeshSimplifier::getCellPosition(size_t cell, Real cellSize) const {
+    const quadric &q = cellQuadrics[cell];
+    const double count = static_cast<double>(cellVertexCounts[cell]);
+    Vector4 position(cellPositionSums[cell].cx() / count, cellPositionSums[cell].cy() / count,
+        cellPositionSums[cell].cz() / count, 1);
+
+    // The position minimizing the quadric solves A x = -b, which is solved by Cramer's rule
+    const double cofactors[3] = { q.a[3] * q.a[5] - q.a[4] * q.a[4], q.a[2] * q.a[4] - q.a[1] * q.a[5], q.a[1] * q.a[4] - q.a[2] * q.a[3] };
+    const double determinant = q.a[0] * cofactors[0] + q.a[1] * cofactors[1] + q.a[2] * cofactors[2];
+    const double trace = q.a[0] + q.a[3] + q.a[5];
+
+    if (!(determinant > singularQuadricScale * trace * trace * trace)) {
+        return position;
+    }
+
+    const double inverse[6] = {
+        cofactors[0], cofactors[1], cofactors[2],
+        q.a[0] * q.a[5] - q.a[2] * q.a[2], q.a[1] * q.a[2] - q.a[0] * q.a[4],
+        q.a[0] * q.a[3] - q.a[1] * q.a[1]
+    };
+    const double solution[3] = {
+        -(inverse[0] * q.b[0] + inverse[1] * q.b[1] + inverse[2] * q.b[2]) / determinant,
+        -(inverse[1] * q.b[0] + inverse[3] * q.b[1] + inverse[4] * q.b[2]) / determinant,
+        -(inverse[2] * q.b[0] + inverse[4] * q.b[1] + inverse[5] * q.b[2]) / determinant
+    };
+
+    // Positions outside of the cell would move vertexes further than the cell diagonal
+    for (size_t j = 0; j < 3; ++j) {
+        const uint64_t coordinate = (cellCoordinates[cell] >> (cellCoordinateBits * j)) & cellCoordinateMask;
+        const double low = gridOrigin.c(j) + double(cellSize) * coordinate;
+
+        if (!(solution[j] >= low && solution[j] <= low + cellSize)) {
+            return position;
+        }
+    }
+
+    return Vector4(solution[0], solution[1], solution[2], 1);
+}
@@ -0,0 +1,58 @@
+#ifndef MESH_SIMPLIFIER_H
+#define MESH_SIMPLIFIER_H
+
+#include <cstdint>
+#include <vector>
+#include "mesh.h"
+
+// Simplifies meshes by vertex clustering. Vertexes in the same cell of a grid are merged and placed where the sum
+// of squared distances to the planes of their triangles is the smallest, so that edges and corners are kept.
+// Vertexes of different colors stay apart, triangles which collapse into a line or a point are dropped.
+class MeshSimplifier {
+
+public:
+
+    MeshSimplifier();
+
+    // Returns false if the mesh is empty or has non finite positions
+    bool simplify(const Mesh &mesh, Real cellSize, Mesh &simplifiedMesh);
+
+    // Farthest any vertex was moved by the last simplification, at most the diagonal of a cell
+    Real getMaximumDisplacement() const;
+
+private:
+
+    // Sum of the squared distances to planes, weighted by the triangle areas
+    struct quadric {
+        double a[6]; // Upper triangle of the sum of n * n^T
+        double b[3]; // Sum of n * d
+    };
+
+    // Merged vertex of one color within a cell, representatives of a cell form a list
+    struct representative {
+        size_t cell;
+        size_t next;
+        Vector4 color;
+        Vector4 normal;
+        size_t vertexCount;
+    };
+
+    Vector4 getCellPosition(size_t cell, Real cellSize) const;
+
+private:
+
+    std::vector<size_t> vertexCells;
+    std::vector<size_t> vertexRepresentatives;
+    std::vector<uint64_t> cellCoordinates;
+    std::vector<quadric> cellQuadrics;
+    std::vector<Vector4> cellPositionSums;
+    std::vector<size_t> cellVertexCounts;
+    std::vector<size_t> cellRepresentatives;
+    std::vector<Vector4> cellPositions;
+    std::vector<representative> representatives;
+    Vector4 gridOrigin;
+    Real maximumDisplacement;
+
+};
+
+#endif
@@ -0,0 +1,168 @@
+#include <algorithm>
+#include "mapped_file.h"
+#include "model_reader.h"
+#include "text_scanner.h"
+
+// Text files are read in blocks of this size, a block holds about 20 thousand vertex lines
+const size_t readBlockSize = 1 << 20;
+
+// Lines are kept whole in the buffer, so a file without line feeds, e.g. a binary file of another format, is rejected
+// once a line grows past this size instead of being read into memory entirely
+const size_t maxLineSize = 1 << 20;
+
+ModelReader::ModelReader() {
+    close();
+}
+
+bool ModelReader::open(const std::string &filePath) {
+    close();
+
+    if (Mesh::isBinaryFile(filePath)) {
+        // Without memory mapping the whole mesh would be read into memory, which streaming is meant to avoid
+        if (!MappedFile::isMappingSupported()) {
+            loadError = "binary meshes are streamed only where files can be memory mapped";
+            return false;
+        }
+
+        if (!mesh.loadFromBinaryFile(filePath)) {
+            loadError = mesh.getLoadError();
+            return false;
+        }
+
+        isBinary = true;
+
+        return true;
+    }
+
+    file.open(filePath, std::ios::binary);
+
+    if (!file.is_open()) {
+        loadError = "cannot open the file";
+        return false;
+    }
+
+    return true;
+}
+
+void ModelReader::close() {
+    isBinary = false;
+    mesh.clear();
+
+    if (file.is_open()) {
+        file.close();
+    }
+
+    rewind();
+}
+
+void ModelReader::rewind() {
+    nextIndex = 0;
+
+    if (file.is_open()) {
+        file.clear();
+        file.seekg(0);
+    }
+
+    buffer.clear();
+    bufferOffset = 0;
+    bufferLineEnd = 0;
+    lineOffset = 0;
+    loadError.clear();
+}
+
+bool ModelReader::readBatch(size_t triangleCount, std::vector<Vertex> &vertexArray) {
+    const size_t vertexCount = 3 * triangleCount;
+
+    vertexArray.clear();
+
+    if (!loadError.empty()) {
+        return false;
+    }
+
+    // Binary meshes are indexed, the vertexes of a batch are gathered from its index range
+    if (isBinary) {
+        const size_t last = std::min(nextIndex + vertexCount, mesh.getIndexCount());
+
+        vertexArray.reserve(last - nextIndex);
+
+        for (; nextIndex < last; ++nextIndex) {
+            vertexArray.push_back(mesh.getVertexes()[mesh.getIndexes()[nextIndex]]);
+        }
+
+        return !vertexArray.empty();
+    }
+
+    while (vertexArray.size() < vertexCount) {
+        if (bufferOffset == bufferLineEnd && !fillBuffer()) {
+            if (!loadError.empty()) {
+                vertexArray.clear();
+                return false;
+            }
+
+            break;
+        }
+
+        TextScanner scanner(buffer.data() + bufferOffset, buffer.data() + bufferLineEnd);
+
+        while (vertexArray.size() < vertexCount && scanner.nextLine()) {
+            Vertex vertex;
+
+            if (!scanner.readVertex(vertex)) {
+                loadError = "line " + std::to_string(lineOffset + scanner.getLineNumber()) + " is not a valid vertex";
+                vertexArray.clear();
+                return false;
+            }
+
+            vertexArray.push_back(vertex);
+        }
+
+        lineOffset += scanner.getLineNumber();
+        bufferOffset = scanner.getCursor() - buffer.data();
+    }
+
+    // Vertexes left over after the last triangle are dropped, as when the whole model is loaded
+    vertexArray.resize(vertexArray.size() - vertexArray.size() % 3);
+
+    return !vertexArray.empty();
+}
+
+const std::string& ModelReader::getLoadError() const {
+    return loadError;
+}
+
+// Replaces the consumed part of the buffer with the next block of the file and finds the end of its last complete line.
+// Returns false when nothing is left to read or the line is too long, which sets the load error.
+bool ModelReader::fillBuffer() {
+    buffer.erase(buffer.begin(), buffer.begin() + bufferOffset);
+    bufferOffset = 0;
+    bufferLineEnd = 0;
+
+    while (file.is_open()) {
+        const size_t size = buffer.size();
+
+        buffer.resize(size + readBlockSize);
+        file.read(buffer.data() + size, readBlockSize);
+        buffer.resize(size + static_cast<size_t>(file.gcount()));
+
+        // The last line of the file may lack a line feed
+        if (!file) {
+            bufferLineEnd = buffer.size();
+            return bufferLineEnd > 0;
+        }
+
+        const auto newLine = std::find(buffer.rbegin(), buffer.rbegin() + (buffer.size() - size), '\n');
+
+        if (newLine != buffer.rbegin() + (buffer.size() - size)) {
+            bufferLineEnd = buffer.rend() - newLine;
+            return true;
+        }
+
+        if (buffer.size() > maxLineSize) {
+            loadError = "line " + std::to_string(lineOffset + 1) + " is longer than " + std::to_string(maxLineSize) + " bytes";
+            buffer.clear();
+            return false;
+        }
+    }
+
+    return false;
+}
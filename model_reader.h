@@ -0,0 +1,52 @@
+#ifndef MODEL_READER_H
+#define MODEL_READER_H
+
+#include <fstream>
+#include <string>
+#include <vector>
+#include "mesh.h"
+#include "vertex.h"
+
+// Reads the triangles of a text or binary model file in batches, so that only one batch of a model
+// has to be kept in memory. Text files are read in blocks, binary meshes are mapped and read by index ranges. Binary
+// meshes fail to open where files cannot be mapped, reading them whole would not keep memory bounded.
+class ModelReader {
+
+public:
+
+    ModelReader();
+
+    bool open(const std::string &filePath);
+    void close();
+
+    // Goes back to the first triangle, so that the model can be read again for the next frame
+    void rewind();
+
+    // Reads at most triangleCount following triangles into vertexArray, every 3 consecutive vertexes form a triangle.
+    // Returns false once no triangle is left or the file turns out to be wrong, which sets the load error.
+    bool readBatch(size_t triangleCount, std::vector<Vertex> &vertexArray);
+
+    // Reason reading failed, naming the first bad line of text files
+    const std::string& getLoadError() const;
+
+private:
+
+    bool fillBuffer();
+
+private:
+
+    bool isBinary;
+    Mesh mesh;
+    size_t nextIndex;
+
+    std::ifstream file;
+    std::vector<char> buffer;
+    size_t bufferOffset;
+    size_t bufferLineEnd;
+    size_t lineOffset;
+
+    std::string loadError;
+
+};
+
+#endif
@@ -0,0 +1,50 @@
+#include <fstream>
+#include "model_streamer.h"
+#include "stage_timer.h"
+
+const std::streamoff streamedFileSize = std::streamoff(1) << 30;
+const size_t batchTriangleCount = 1 << 16;
+
+bool ModelStreamer::isStreamedFile(const std::string &filePath) {
+    std::ifstream file(filePath, std::ios::binary | std::ios::ate);
+
+    return file.is_open() && static_cast<std::streamoff>(file.tellg()) > streamedFileSize;
+}
+
+bool ModelStreamer::open(const std::string &filePath) {
+    return modelReader.open(filePath);
+}
+
+void ModelStreamer::close() {
+    modelReader.close();
+    vertexArray.clear();
+}
+
+bool ModelStreamer::drawFrame(TransformEngine &transformEngine, RenderEngine &renderEngine, FrameStatistics &frameStatistics) {
+    StageTimer readTimer;
+
+    modelReader.rewind();
+    renderEngine.beginFrame();
+    frameStatistics = FrameStatistics();
+
+    while (modelReader.readBatch(batchTriangleCount, vertexArray)) {
+        transformEngine.loadBatchFromVertexArray(vertexArray);
+        frameStatistics.readTime += readTimer.getMilliseconds();
+
+        transformEngine.run();
+        renderEngine.drawVertexArray(transformEngine.getTransformedVertexes(), transformEngine.getTransformedIndexes());
+        frameStatistics.addTransformStatistics(transformEngine);
+
+        readTimer.restart();
+    }
+
+    frameStatistics.readTime += readTimer.getMilliseconds();
+    transformEngine.clearModel();
+    frameStatistics.setRenderStatistics(renderEngine);
+
+    return modelReader.getLoadError().empty();
+}
+
+const std::string& ModelStreamer::getLoadError() const {
+    return modelReader.getLoadError();
+}
@@ -0,0 +1,37 @@
+#ifndef MODEL_STREAMER_H
+#define MODEL_STREAMER_H
+
+#include <string>
+#include <vector>
+#include "frame_statistics.h"
+#include "model_reader.h"
+#include "render_engine.h"
+#include "transform_engine.h"
+
+// Draws models from files too large to be loaded. Every frame reads the model again in batches, then transforms, clips
+// and draws each batch into the depth buffer shared by the frame, so that only one batch is held in memory.
+class ModelStreamer {
+
+public:
+
+    // Models in files larger than 1 GiB are streamed instead of loaded
+    static bool isStreamedFile(const std::string &filePath);
+
+    bool open(const std::string &filePath);
+    void close();
+
+    // Returns false if the model file turns out to be wrong, which sets the load error. Reading the batches is timed
+    // as the read time of the frame.
+    bool drawFrame(TransformEngine &transformEngine, RenderEngine &renderEngine, FrameStatistics &frameStatistics);
+
+    // Reason reading failed, naming the first bad line of text files
+    const std::string& getLoadError() const;
+
+private:
+
+    ModelReader modelReader;
+    std::vector<Vertex> vertexArray;
+
+};
+
+#endif
@@ -0,0 +1,11 @@
+#ifndef REAL_H
+#define REAL_H
+
+// Scalar type of the whole pipeline, single precision builds define USE_SINGLE_PRECISION
+#if defined(USE_SINGLE_PRECISION)
+typedef float Real;
+#else
+typedef double Real;
+#endif
+
+#endif
@@ -1,7 +1,26 @@
 #include "render_engine.h"
 #include <algorithm>
-#include <list>
-#include <map>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// Screen coordinates are snapped to 1/256 of a pixel for the half-space rasterizer
+const int64_t subpixelBits = 8;
+const int64_t subpixelScale = 1 << subpixelBits;
+const Real maxSubpixelCoordinate = 1 << 22;
+
+// The half-space rasterizer bins triangles into square tiles which are processed in parallel
+const size_t tileSize = 32;
+
+// Tiles are split into blocks which keep a conservative farthest depth for occlusion culling
+const size_t blockSize = 8;
+const size_t blocksPerTileSide = tileSize / blockSize;
+// Covers the rounding of incrementally stepped depths, which is much coarser in single precision
+const Real depthEpsilon = sizeof(Real) < sizeof(double) ? 1e-5 : 1e-9;
 
 struct section {
     Vector4 begin;
@@ -14,28 +33,24 @@ struct section {
         this->primitive = primitive;
     }
 
-    bool operator<(const section& right) const {
-        return getTop() < right.getTop();
-    }
-
-    double getTop() const {
+    Real getTop() const {
         return std::min(begin.cy(), end.cy());
     }
 
-    double getBottom() const {
+    Real getBottom() const {
         return std::max(begin.cy(), end.cy());
     }
 
-    double getLeft() const {
+    Real getLeft() const {
         return std::min(begin.cx(), end.cx());
     }
 
-    double getRight() const {
+    Real getRight() const {
         return std::max(begin.cx(), end.cx());
     }
 };
 
-double getInterpolation(double x0, double y0, double x1, double y1, double x) {
+Real getInterpolation(Real x0, Real y0, Real x1, Real y1, Real x) {
     if (std::abs(x1 - x0) < 0.0001) {
         return (y0 + y1) / 2;
     }
@@ -43,28 +58,212 @@ double getInterpolation(double x0, double y0, double x1, double y1, double x) {
     return (y0 * (x1 - x) + y1 * (x - x0)) / (x1 - x0);
 }
 
-Vector4 getIntersection(const section& s, double y) {
-    double x = getInterpolation(s.begin.cy(), s.begin.cx(), s.end.cy(), s.end.cx(), y);
-    double z = getInterpolation(s.begin.cx(), s.begin.cz(), s.end.cx(), s.end.cz(), x);
+Vector4 getIntersection(const section& s, Real y) {
+    Real x = getInterpolation(s.begin.cy(), s.begin.cx(), s.end.cy(), s.end.cx(), y);
+    Real z = getInterpolation(s.begin.cx(), s.begin.cz(), s.end.cx(), s.end.cz(), x);
     
     return Vector4(x, y, z);
 }
 
+struct triangle {
+    size_t primitive;
+    int64_t x[3], y[3];
+    int64_t left, right, top, bottom;
+    Real z, dz1, dz2;
+    Real maxDepth;
+
+    // Snaps the triangle to the subpixel grid, returns false if it covers no pixel center
+    bool setup(const Vector4 &va, const Vector4 &vb, const Vector4 &vc, size_t primitive, size_t viewWidth, size_t viewHeight) {
+        const Vector4 *v[3] = {&va, &vb, &vc};
+
+        for (size_t j = 0; j < 3; ++j) {
+            // Also rejects NaN coordinates
+            if (!(std::abs(v[j]->cx()) < maxSubpixelCoordinate && std::abs(v[j]->cy()) < maxSubpixelCoordinate)) {
+                return false;
+            }
+
+            x[j] = static_cast<int64_t>(std::llround(v[j]->cx() * subpixelScale));
+            y[j] = static_cast<int64_t>(std::llround(v[j]->cy() * subpixelScale));
+        }
+
+        int64_t area = (x[1] - x[0]) * (y[2] - y[0]) - (y[1] - y[0]) * (x[2] - x[0]);
+
+        if (area == 0) {
+            return false;
+        }
+
+        // Clockwise triangles are flipped so that inside means non negative edge functions
+        if (area < 0) {
+            std::swap(x[1], x[2]);
+            std::swap(y[1], y[2]);
+            std::swap(v[1], v[2]);
+            area = -area;
+        }
+
+        left = std::max<int64_t>((std::min(std::min(x[0], x[1]), x[2]) + subpixelScale - 1) >> subpixelBits, 0);
+        right = std::min<int64_t>(std::max(std::max(x[0], x[1]), x[2]) >> subpixelBits, viewWidth - Real(1));
+        top = std::max<int64_t>((std::min(std::min(y[0], y[1]), y[2]) + subpixelScale - 1) >> subpixelBits, 0);
+        bottom = std::min<int64_t>(std::max(std::max(y[0], y[1]), y[2]) >> subpixelBits, viewHeight - Real(1));
+
+        this->primitive = primitive;
+        z = v[0]->cz();
+        dz1 = (v[1]->cz() - v[0]->cz()) / area;
+        dz2 = (v[2]->cz() - v[0]->cz()) / area;
+        maxDepth = std::max(std::max(v[0]->cz(), v[1]->cz()), v[2]->cz());
+
+        return left <= right && top <= bottom;
+    }
+
+    // Edge function of edge j at pixel center (px, py), positive on the side of vertex j
+    int64_t getEdge(size_t j, int64_t px, int64_t py) const {
+        const size_t a = (j+1) % 3;
+        const size_t b = (j+2) % 3;
+
+        return (x[b] - x[a]) * ((py << subpixelBits) - y[a]) - (y[b] - y[a]) * ((px << subpixelBits) - x[a]);
+    }
+
+    int64_t getEdgeStepX(size_t j) const {
+        return -(y[(j+2) % 3] - y[(j+1) % 3]) * subpixelScale;
+    }
+
+    int64_t getEdgeStepY(size_t j) const {
+        return (x[(j+2) % 3] - x[(j+1) % 3]) * subpixelScale;
+    }
+
+    Real getDepth(int64_t px, int64_t py) const {
+        return z + getEdge(1, px, py) * dz1 + getEdge(2, px, py) * dz2;
+    }
+
+    // True if all pixel centers of the rectangle are inside
+    bool covers(int64_t rectLeft, int64_t rectTop, int64_t rectRight, int64_t rectBottom) const {
+        for (size_t j = 0; j < 3; ++j) {
+            const int64_t px = getEdgeStepX(j) > 0 ? rectLeft : rectRight;
+            const int64_t py = getEdgeStepY(j) > 0 ? rectTop : rectBottom;
+
+            if (getEdge(j, px, py) < 0) {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    // Conservative test, false only if the rectangle lies entirely outside one of the edges
+    bool overlaps(int64_t rectLeft, int64_t rectTop, int64_t rectRight, int64_t rectBottom) const {
+        for (size_t j = 0; j < 3; ++j) {
+            const int64_t px = getEdgeStepX(j) > 0 ? rectRight : rectLeft;
+            const int64_t py = getEdgeStepY(j) > 0 ? rectBottom : rectTop;
+
+            if (getEdge(j, px, py) < 0) {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    // Returns the number of covered pixels
+    size_t rasterize(int64_t rectLeft, int64_t rectTop, int64_t rectRight, int64_t rectBottom, size_t viewWidth,
+            std::vector<Real> &depthBuffer, std::vector<size_t> &primitiveBuffer) const {
+        const int64_t minX = std::max(left, rectLeft);
+        const int64_t maxX = std::min(right, rectRight);
+        const int64_t minY = std::max(top, rectTop);
+        const int64_t maxY = std::min(bottom, rectBottom);
+        int64_t stepX[3], stepY[3], rowEdge[3];
+
+        for (size_t j = 0; j < 3; ++j) {
+            stepX[j] = getEdgeStepX(j);
+            stepY[j] = getEdgeStepY(j);
+            rowEdge[j] = getEdge(j, minX, minY);
+        }
+
+        const Real depthStepX = stepX[1] * dz1 + stepX[2] * dz2;
+        size_t fragmentCount = 0;
+
+        for (int64_t py = minY; py <= maxY; ++py) {
+            int64_t edge[3] = {rowEdge[0], rowEdge[1], rowEdge[2]};
+            Real depth = z + edge[1] * dz1 + edge[2] * dz2;
+
+            for (int64_t px = minX; px <= maxX; ++px) {
+                if ((edge[0] | edge[1] | edge[2]) >= 0) {
+                    const size_t pixel = py * viewWidth + px;
+                    ++fragmentCount;
+
+                    if (depth > depthBuffer[pixel]) {
+                        depthBuffer[pixel] = depth;
+                        primitiveBuffer[pixel] = primitive;
+                    }
+                }
+
+                for (size_t j = 0; j < 3; ++j) {
+                    edge[j] += stepX[j];
+                }
+
+                depth += depthStepX;
+            }
+
+            for (size_t j = 0; j < 3; ++j) {
+                rowEdge[j] += stepY[j];
+            }
+        }
+
+        return fragmentCount;
+    }
+};
+
+// Converts RGBA float pixels to RGBA8, four pixels at a time where SSE2 is available
+void packPixels(const float *input, uint8_t *output, size_t pixelCount) {
+    size_t i = 0;
+
+#if defined(__SSE2__)
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 scale = _mm_set1_ps(255.0f);
+    const __m128 half = _mm_set1_ps(0.5f);
+
+    for (; i + 4 <= pixelCount; i += 4) {
+        __m128i channels[4];
+
+        for (size_t j = 0; j < 4; ++j) {
+            __m128 pixel = _mm_loadu_ps(input + 4 * (i + j));
+            pixel = _mm_min_ps(_mm_max_ps(pixel, zero), one);
+            channels[j] = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(pixel, scale), half));
+        }
+
+        const __m128i low = _mm_packs_epi32(channels[0], channels[1]);
+        const __m128i high = _mm_packs_epi32(channels[2], channels[3]);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(output + 4 * i), _mm_packus_epi16(low, high));
+    }
+#endif
+
+    for (; i < pixelCount; ++i) {
+        for (size_t j = 0; j < 4; ++j) {
+            // NaN goes to zero like in the vector path, casting it would be undefined
+            const float channel = input[4 * i + j];
+            const float value = !(channel > 0.0f) ? 0.0f : channel < 1.0f ? channel : 1.0f;
+            output[4 * i + j] = static_cast<uint8_t>(value * 255.0f + 0.5f);
+        }
+    }
+}
+
 RenderEngine::RenderEngine() {
     viewWidth = 512;
     viewHeight = 512;
     backgroundColor = Vector4(0, 0, 0, 1);
+    rasterizationMode = RasterizationModes::Scanline;
+    lightCacheViewRevision = 0;
+    floatImageEnabled = false;
 }
 
 LightEngine& RenderEngine::getLightEngine() {
     return lightEngine;
 }
 
-double RenderEngine::getViewWidth() const {
+Real RenderEngine::getViewWidth() const {
     return viewWidth;
 }
 
-double RenderEngine::getViewHeight() const {
+Real RenderEngine::getViewHeight() const {
     return viewHeight;
 }
 
@@ -81,182 +280,702 @@ void RenderEngine::setBackgroundColor(Vector4 backgroundColor) {
     this->backgroundColor = backgroundColor;
 }
 
+RasterizationModes RenderEngine::getRasterizationMode() const {
+    return rasterizationMode;
+}
+
+void RenderEngine::setRasterizationMode(RasterizationModes rasterizationMode) {
+    this->rasterizationMode = rasterizationMode;
+}
+
+size_t RenderEngine::getThreadCount() const {
+    return threadPool.getThreadCount();
+}
+
+void RenderEngine::setThreadCount(size_t threadCount) {
+    threadPool.setThreadCount(threadCount);
+}
+
+bool RenderEngine::isFloatImageEnabled() const {
+    return floatImageEnabled;
+}
+
+void RenderEngine::setFloatImageEnabled(bool floatImageEnabled) {
+    this->floatImageEnabled = floatImageEnabled;
+
+    if (!floatImageEnabled) {
+        floatImage.clear();
+        floatImage.shrink_to_fit();
+    }
+}
+
 void RenderEngine::setVertexArray(const std::vector<Vertex> &vertexArray) {
-    this->vertexArray.clear();
-    this->vertexArray.insert(this->vertexArray.end(), vertexArray.begin(), vertexArray.end());
+    std::vector<size_t> indexArray(vertexArray.size() - vertexArray.size() % 3);
+
+    for (size_t i = 0; i < indexArray.size(); ++i) {
+        indexArray[i] = i;
+    }
+
+    setVertexArray(vertexArray, indexArray);
+}
+
+void RenderEngine::setVertexArray(const std::vector<Vertex> &vertexArray, const std::vector<size_t> &indexArray) {
+    this->vertexArray.assign(vertexArray.begin(), vertexArray.end());
+    this->indexArray.assign(indexArray.begin(), indexArray.end());
 }
 
 void RenderEngine::run() {
-    size_t nextEdge = 0;
-    std::vector<section> edges;
-    std::list<section*> edgeBuffer;
+    image.resize(4 * viewWidth * viewHeight);
+
+    if (floatImageEnabled) {
+        floatImage.resize(4 * viewWidth * viewHeight);
+    }
+
+    if (viewWidth == 0 || viewHeight == 0) {
+        return;
+    }
+
+    occlusionStatistics = OcclusionStatistics();
+    renderStatistics = RenderStatistics();
+    renderStatistics.triangleCount = indexArray.size() / 3;
+
+    StageTimer timer;
+    lightVertexes(true);
+    renderStatistics.lightTime = timer.getMilliseconds();
+
+    timer.restart();
+    setupGradients();
+    const double gradientTime = timer.getMilliseconds();
+    renderStatistics.shadeTime = gradientTime;
+
+    // The rasterizers add the time they spend shading rows
+    timer.restart();
+
+    if (rasterizationMode == RasterizationModes::HalfSpace) {
+        clearFrame();
+        rasterizeHalfSpace();
+    } else {
+        rasterizeScanline();
+    }
+
+    renderStatistics.rasterTime = timer.getMilliseconds() - (renderStatistics.shadeTime - gradientTime);
+}
 
-    image.resize(viewWidth * viewHeight);
+void RenderEngine::beginFrame() {
+    image.resize(4 * viewWidth * viewHeight);
 
-    for (size_t i = 2; i < vertexArray.size(); i = i + 3) {
+    if (floatImageEnabled) {
+        floatImage.resize(4 * viewWidth * viewHeight);
+    }
+
+    occlusionStatistics = OcclusionStatistics();
+    renderStatistics = RenderStatistics();
+
+    const StageTimer timer;
+    clearFrame();
+    renderStatistics.rasterTime = timer.getMilliseconds();
+}
+
+void RenderEngine::drawVertexArray(const std::vector<Vertex> &vertexArray, const std::vector<size_t> &indexArray) {
+    if (viewWidth == 0 || viewHeight == 0) {
+        return;
+    }
+
+    setVertexArray(vertexArray, indexArray);
+    renderStatistics.triangleCount += this->indexArray.size() / 3;
+
+    StageTimer timer;
+    lightVertexes(false);
+    renderStatistics.lightTime += timer.getMilliseconds();
+
+    timer.restart();
+    setupGradients();
+    const double shadeTime = renderStatistics.shadeTime + timer.getMilliseconds();
+    renderStatistics.shadeTime = shadeTime;
+
+    timer.restart();
+    rasterizeHalfSpace();
+    renderStatistics.rasterTime += timer.getMilliseconds() - (renderStatistics.shadeTime - shadeTime);
+}
+
+const OcclusionStatistics& RenderEngine::getOcclusionStatistics() const {
+    return occlusionStatistics;
+}
+
+const RenderStatistics& RenderEngine::getRenderStatistics() const {
+    return renderStatistics;
+}
+
+const std::vector<uint8_t>& RenderEngine::getImage() const {
+    return image;
+}
+
+const std::vector<float>& RenderEngine::getFloatImage() const {
+    return floatImage;
+}
+
+// Fills the image with the background and resets the depth buffer and the depth pyramid of the half-space rasterizer
+void RenderEngine::clearFrame() {
+    const size_t tileCount = ((viewWidth + tileSize - 1) / tileSize) * ((viewHeight + tileSize - 1) / tileSize);
+
+    depthBuffer.assign(viewWidth * viewHeight, -std::numeric_limits<Real>::infinity());
+    primitiveBuffer.assign(viewWidth * viewHeight, SIZE_MAX);
+    blockDepthBuffer.assign(tileCount * blocksPerTileSide * blocksPerTileSide, -std::numeric_limits<Real>::infinity());
+
+    std::vector<float> backgroundPixels(4 * viewWidth);
+
+    for (size_t x = 0; x < viewWidth; ++x) {
+        for (size_t k = 0; k < 4; ++k) {
+            backgroundPixels[4 * x + k] = backgroundColor.c(k);
+        }
+    }
+
+    for (size_t y = 0; y < viewHeight; ++y) {
+        if (floatImageEnabled) {
+            std::copy(backgroundPixels.begin(), backgroundPixels.end(), floatImage.begin() + 4 * y * viewWidth);
+        }
+
+        packPixels(backgroundPixels.data(), &image[4 * y * viewWidth], viewWidth);
+    }
+}
+
+void RenderEngine::rasterizeScanline() {
+    const size_t primitiveCount = indexArray.size() / 3;
+    std::vector<section> edges;
+    std::vector<size_t> edgeTop, edgeBottom;
+    std::vector<size_t> edgeTable(viewHeight + 1, 0);
+    std::vector<size_t> edgeOrder;
+    std::vector<size_t> activeEdges;
+    std::vector<unsigned char> primitiveEdgeCount(primitiveCount, 0);
+    std::vector<size_t> primitiveEdge(primitiveCount);
+    std::vector<section> ranges;
+    std::vector<size_t> rangeLeft, rangeRight;
+    std::vector<size_t> rangeOrder;
+    std::vector<size_t> activeRanges;
+    std::vector<size_t> rowPrimitives(viewWidth);
+    std::vector<float> rowPixels(floatImageEnabled ? 0 : 4 * viewWidth);
+
+    // Edge table: every edge is bucketed by the first row it crosses, rows are
+    // the integer y values satisfying top <= y <= bottom
+    for (size_t i = 2; i < indexArray.size(); i = i + 3) {
         for (size_t j = 0; j < 3; ++j) {
-            const size_t va = (i-2) + j;
-            const size_t vb = (i-2) + (j+1) % 3;
-            edges.emplace_back(vertexArray[va].position, vertexArray[vb].position, i/3);
+            const size_t va = indexArray[(i-2) + j];
+            const size_t vb = indexArray[(i-2) + (j+1) % 3];
+            const section edge(vertexArray[va].position, vertexArray[vb].position, i/3);
+            const Real top = std::max(std::ceil(edge.getTop()), Real(0));
+            const Real bottom = std::min(std::floor(edge.getBottom()), viewHeight - Real(1));
+
+            if (!(top <= bottom)) {
+                continue;
+            }
+
+            edges.push_back(edge);
+            edgeTop.push_back(static_cast<size_t>(top));
+            edgeBottom.push_back(static_cast<size_t>(bottom));
+            ++edgeTable[edgeTop.back() + 1];
+        }
+    }
+
+    for (size_t y = 0; y < viewHeight; ++y) {
+        edgeTable[y + 1] += edgeTable[y];
+    }
+
+    edgeOrder.resize(edges.size());
+
+    {
+        std::vector<size_t> edgeSlot(edgeTable.begin(), edgeTable.end() - 1);
+
+        for (size_t i = 0; i < edges.size(); ++i) {
+            edgeOrder[edgeSlot[edgeTop[i]]++] = i;
         }
     }
-    
-    std::sort(edges.begin(), edges.end());
 
     for (size_t y = 0; y < viewHeight; ++y) {
-        std::map<size_t, std::vector<section*> > edgeMap;
-        std::vector<section> ranges;
-        
-        while (nextEdge < edges.size() && edges[nextEdge].getTop() <= y) {
-            edgeBuffer.push_back(&edges[nextEdge]);
-            ++nextEdge;
-        }
-        
-        for (auto it = edgeBuffer.begin(); it != edgeBuffer.end();) {
-            if ((*it)->getBottom() < y) {
-                it = edgeBuffer.erase(it);
-            } else {
-                ++it;
+        // Update active edge table
+        size_t activeEdgeCount = 0;
+
+        for (size_t i = 0; i < activeEdges.size(); ++i) {
+            if (edgeBottom[activeEdges[i]] >= y) {
+                activeEdges[activeEdgeCount++] = activeEdges[i];
             }
         }
 
-        for (auto it = edgeBuffer.begin(); it != edgeBuffer.end(); ++it) {
-            edgeMap[(*it)->primitive].push_back(*it);
+        activeEdges.resize(activeEdgeCount);
+        activeEdges.insert(activeEdges.end(), edgeOrder.begin() + edgeTable[y], edgeOrder.begin() + edgeTable[y + 1]);
+
+        // Primitives crossing the row with exactly two edges produce a range
+        for (size_t i = 0; i < activeEdges.size(); ++i) {
+            const size_t primitive = edges[activeEdges[i]].primitive;
+
+            if (primitiveEdgeCount[primitive]++ == 0) {
+                primitiveEdge[primitive] = activeEdges[i];
+            }
         }
 
-        for (auto it = edgeMap.begin(); it != edgeMap.end(); ++it) {
-            if (it->second.size() == 2) {
-                const auto ia = getIntersection(*(it->second[0]), y);
-                const auto ib = getIntersection(*(it->second[1]), y);
-                ranges.emplace_back(ia, ib, it->first);
-            } else if (!it->second.empty()) {
+        ranges.clear();
+        rangeLeft.clear();
+        rangeRight.clear();
+
+        for (size_t i = 0; i < activeEdges.size(); ++i) {
+            const section &edge = edges[activeEdges[i]];
+            const size_t primitive = edge.primitive;
+
+            if (primitiveEdgeCount[primitive] == 2 && primitiveEdge[primitive] != activeEdges[i]) {
+                const auto ia = getIntersection(edges[primitiveEdge[primitive]], y);
+                const auto ib = getIntersection(edge, y);
+                const section range(ia, ib, primitive);
+                const Real left = std::max(std::ceil(range.getLeft()), Real(0));
+                const Real right = std::min(std::floor(range.getRight()), viewWidth - Real(1));
+
+                if (left <= right) {
+                    ranges.push_back(range);
+                    rangeLeft.push_back(static_cast<size_t>(left));
+                    rangeRight.push_back(static_cast<size_t>(right));
+                }
+            } else if (primitiveEdgeCount[primitive] > 2) {
                 // TODO handle minor cases
             }
         }
 
-        // TODO sort ranges and update rangeBuffer as you go
+        for (size_t i = 0; i < activeEdges.size(); ++i) {
+            primitiveEdgeCount[edges[activeEdges[i]].primitive] = 0;
+        }
+
+        // Ranges sorted by the first column they cover
+        rangeOrder.resize(ranges.size());
+
+        for (size_t i = 0; i < ranges.size(); ++i) {
+            rangeOrder[i] = i;
+        }
+
+        std::sort(rangeOrder.begin(), rangeOrder.end(), [&rangeLeft](size_t a, size_t b) {
+            return rangeLeft[a] < rangeLeft[b];
+        });
+
+        size_t nextRange = 0;
+        activeRanges.clear();
 
         for (size_t x = 0; x < viewWidth; ++x) {
-            std::vector<section*> rangeBuffer;
+            size_t activeRangeCount = 0;
 
-            // TODO optimize
-            for (size_t i = 0; i < ranges.size(); ++i) {
-                if (x >= ranges[i].getLeft() && x <= ranges[i].getRight()) {
-                    rangeBuffer.push_back(&ranges[i]);
+            for (size_t i = 0; i < activeRanges.size(); ++i) {
+                if (rangeRight[activeRanges[i]] >= x) {
+                    activeRanges[activeRangeCount++] = activeRanges[i];
                 }
             }
 
-            if (rangeBuffer.empty()) {
-                image[y * viewWidth + x] = backgroundColor;
-            } else {
-                size_t frontRange = 0;
-                double frontDistance = getInterpolation(rangeBuffer[0]->begin.cx(), rangeBuffer[0]->begin.cz(), rangeBuffer[0]->end.cx(), rangeBuffer[0]->end.cz(), x);
-
-                for (size_t i = 1; i < rangeBuffer.size(); ++i) {
-                    double distance = getInterpolation(rangeBuffer[i]->begin.cx(), rangeBuffer[i]->begin.cz(), rangeBuffer[i]->end.cx(), rangeBuffer[i]->end.cz(), x);
-                    if (distance > frontDistance) {
-                        frontRange = i;
-                        frontDistance = distance;
+            activeRanges.resize(activeRangeCount);
+
+            while (nextRange < rangeOrder.size() && rangeLeft[rangeOrder[nextRange]] <= x) {
+                activeRanges.push_back(rangeOrder[nextRange]);
+                ++nextRange;
+            }
+
+            if (activeRanges.empty()) {
+                const size_t nextX = nextRange < rangeOrder.size() ? rangeLeft[rangeOrder[nextRange]] : viewWidth;
+
+                std::fill(rowPrimitives.begin() + x, rowPrimitives.begin() + nextX, SIZE_MAX);
+                x = nextX - 1;
+                continue;
+            }
+
+            renderStatistics.fragmentCount += activeRanges.size();
+            ++renderStatistics.shadedPixelCount;
+
+            // Closest range wins, ties go to the primitive drawn first
+            const section *frontRange = &ranges[activeRanges[0]];
+            Real frontDistance = getInterpolation(frontRange->begin.cx(), frontRange->begin.cz(), frontRange->end.cx(), frontRange->end.cz(), x);
+
+            for (size_t i = 1; i < activeRanges.size(); ++i) {
+                const section *range = &ranges[activeRanges[i]];
+                Real distance = getInterpolation(range->begin.cx(), range->begin.cz(), range->end.cx(), range->end.cz(), x);
+
+                if (distance > frontDistance || (distance == frontDistance && range->primitive < frontRange->primitive)) {
+                    frontRange = range;
+                    frontDistance = distance;
+                }
+            }
+
+            rowPrimitives[x] = frontRange->primitive;
+        }
+
+        const StageTimer shadeTimer;
+        float *pixels = floatImageEnabled ? &floatImage[4 * y * viewWidth] : rowPixels.data();
+        shadeRow(y, 0, viewWidth - 1, rowPrimitives.data(), pixels);
+        packPixels(pixels, &image[4 * y * viewWidth], viewWidth);
+        renderStatistics.shadeTime += shadeTimer.getMilliseconds();
+    }
+}
+
+void RenderEngine::rasterizeHalfSpace() {
+    const size_t tileCountX = (viewWidth + tileSize - 1) / tileSize;
+    const size_t tileCountY = (viewHeight + tileSize - 1) / tileSize;
+    std::vector<triangle> triangles;
+    std::vector<size_t> tileBinOffsets(tileCountX * tileCountY + 1, 0);
+    std::vector<size_t> tileBins;
+
+    for (size_t i = 2; i < indexArray.size(); i = i + 3) {
+        triangle t;
+
+        if (t.setup(vertexArray[indexArray[i-2]].position, vertexArray[indexArray[i-1]].position, vertexArray[indexArray[i]].position,
+                i/3, viewWidth, viewHeight)) {
+            triangles.push_back(t);
+        }
+    }
+
+    // Triangles are binned twice, first to size the bins and then to fill them in primitive order
+    for (size_t pass = 0; pass < 2; ++pass) {
+        std::vector<size_t> tileBinSlots(tileBinOffsets.begin(), tileBinOffsets.end() - 1);
+
+        for (size_t i = 0; i < triangles.size(); ++i) {
+            const triangle &t = triangles[i];
+
+            for (int64_t tileY = t.top / tileSize; tileY <= t.bottom / static_cast<int64_t>(tileSize); ++tileY) {
+                for (int64_t tileX = t.left / tileSize; tileX <= t.right / static_cast<int64_t>(tileSize); ++tileX) {
+                    if (!t.overlaps(tileX * tileSize, tileY * tileSize, (tileX+1) * tileSize - 1, (tileY+1) * tileSize - 1)) {
+                        continue;
+                    }
+
+                    const size_t tile = tileY * tileCountX + tileX;
+
+                    if (pass == 0) {
+                        ++tileBinOffsets[tile + 1];
+                    } else {
+                        tileBins[tileBinSlots[tile]++] = i;
                     }
                 }
+            }
+        }
 
-                const auto color = getGradientColor({
-                        vertexArray[3 * rangeBuffer[frontRange]->primitive + 0],
-                        vertexArray[3 * rangeBuffer[frontRange]->primitive + 1],
-                        vertexArray[3 * rangeBuffer[frontRange]->primitive + 2]
-                    }, Vector4(x, y));
-
-                const auto light = getLight({
-                        vertexArray[3 * rangeBuffer[frontRange]->primitive + 0],
-                        vertexArray[3 * rangeBuffer[frontRange]->primitive + 1],
-                        vertexArray[3 * rangeBuffer[frontRange]->primitive + 2]
-                    }, Vector4(x, y));
-                
-                image[y * viewWidth + x] = Vector4(
-                    light.cx() * color.cx(),
-                    light.cy() * color.cy(),
-                    light.cz() * color.cz(),
-                    light.cw() * color.cw());
+        if (pass == 0) {
+            for (size_t tile = 0; tile < tileCountX * tileCountY; ++tile) {
+                tileBinOffsets[tile + 1] += tileBinOffsets[tile];
             }
+
+            tileBins.resize(tileBinOffsets.back());
         }
     }
-}
 
-const std::vector<Vector4>& RenderEngine::getImage() {
-    return image;
-}
+    std::atomic<size_t> occlusionCulledTriangleCount(0);
+    std::atomic<size_t> occlusionCulledBlockCount(0);
+    std::atomic<size_t> fragmentCount(0);
+    std::atomic<size_t> shadedPixelCount(0);
+    std::vector<double> tileRasterTimes(tileCountX * tileCountY, 0);
+    std::vector<double> tileShadeTimes(tileCountX * tileCountY, 0);
+    const StageTimer tileTimer;
+
+    // Every tile owns its part of the buffers, so tiles are rasterized and shaded without locking. The depth buffer
+    // and the depth pyramid persist between the draws of a frame, the primitive buffer only holds the current draw.
+    threadPool.run(tileCountX * tileCountY, [&](size_t tile) {
+        const int64_t left = (tile % tileCountX) * tileSize;
+        const int64_t top = (tile / tileCountX) * tileSize;
+        const int64_t right = std::min<int64_t>(left + tileSize, viewWidth) - 1;
+        const int64_t bottom = std::min<int64_t>(top + tileSize, viewHeight) - 1;
+
+        if (tileBinOffsets[tile] == tileBinOffsets[tile + 1]) {
+            return;
+        }
 
-Vector4 RenderEngine::getGradientColor(const std::vector<Vertex> &primitive, Vector4 position) {
-    Vector4 gradientColor;
-    std::vector <Vertex> referenceVertexes;
+        StageTimer timer;
 
-    for (size_t i = 0; i < primitive.size(); ++i) {
-        auto topIndex = i;
-        auto bottomIndex = (i+1) % primitive.size();
-        auto top = primitive[topIndex].position.cy();
-        auto bottom = primitive[(i+1) % primitive.size()].position.cy();
+        for (int64_t y = top; y <= bottom; ++y) {
+            std::fill(primitiveBuffer.begin() + y * viewWidth + left, primitiveBuffer.begin() + y * viewWidth + right + 1, SIZE_MAX);
+        }
+
+        // Depth pyramid of the tile: every depth stored in a block is at least its block depth
+        // and every depth stored in the tile is at least the tile depth
+        Real *blockDepths = &blockDepthBuffer[tile * blocksPerTileSide * blocksPerTileSide];
+        Real tileDepth = *std::min_element(blockDepths, blockDepths + blocksPerTileSide * blocksPerTileSide);
+        size_t culledTriangleCount = 0;
+        size_t culledBlockCount = 0;
+        size_t tileFragmentCount = 0;
+        size_t tileShadedPixelCount = 0;
+
+        for (size_t i = tileBinOffsets[tile]; i < tileBinOffsets[tile + 1]; ++i) {
+            const triangle &t = triangles[tileBins[i]];
+
+            if (t.maxDepth <= tileDepth) {
+                ++culledTriangleCount;
+                continue;
+            }
+
+            const int64_t minX = std::max(t.left, left);
+            const int64_t maxX = std::min(t.right, right);
+            const int64_t minY = std::max(t.top, top);
+            const int64_t maxY = std::min(t.bottom, bottom);
+            bool isBlockDepthUpdated = false;
+
+            for (int64_t blockY = (minY - top) / blockSize; blockY <= (maxY - top) / static_cast<int64_t>(blockSize); ++blockY) {
+                for (int64_t blockX = (minX - left) / blockSize; blockX <= (maxX - left) / static_cast<int64_t>(blockSize); ++blockX) {
+                    const int64_t blockLeft = left + blockX * blockSize;
+                    const int64_t blockTop = top + blockY * blockSize;
+                    const int64_t blockRight = std::min<int64_t>(blockLeft + blockSize - 1, right);
+                    const int64_t blockBottom = std::min<int64_t>(blockTop + blockSize - 1, bottom);
+                    Real &blockDepth = blockDepths[blockY * blocksPerTileSide + blockX];
+
+                    // Depth is linear, so its extremes over the block lie in the block corners
+                    const Real cornerDepths[4] = {
+                        t.getDepth(blockLeft, blockTop), t.getDepth(blockRight, blockTop),
+                        t.getDepth(blockLeft, blockBottom), t.getDepth(blockRight, blockBottom)
+                    };
+                    const Real nearestDepth = std::min(t.maxDepth, *std::max_element(cornerDepths, cornerDepths + 4));
+
+                    if (nearestDepth + depthEpsilon <= blockDepth) {
+                        ++culledBlockCount;
+                        continue;
+                    }
 
-        if (top > bottom) {
-            std::swap(top, bottom);
-            std::swap(topIndex, bottomIndex);
+                    tileFragmentCount += t.rasterize(std::max(blockLeft, minX), std::max(blockTop, minY), std::min(blockRight, maxX),
+                        std::min(blockBottom, maxY), viewWidth, depthBuffer, primitiveBuffer);
+
+                    if (t.covers(blockLeft, blockTop, blockRight, blockBottom)) {
+                        blockDepth = std::max(blockDepth, *std::min_element(cornerDepths, cornerDepths + 4) - depthEpsilon);
+                        isBlockDepthUpdated = true;
+                    }
+                }
+            }
+
+            if (isBlockDepthUpdated) {
+                tileDepth = *std::min_element(blockDepths, blockDepths + blocksPerTileSide * blocksPerTileSide);
+            }
         }
 
-        if (position.cy() >= top && position.cy() <= bottom) {
-            Vertex vertex;
-            vertex.position.x() = getInterpolation(
-                primitive[i].position.cy(), primitive[i].position.cx(),
-                primitive[(i+1) % primitive.size()].position.cy(), primitive[(i+1) % primitive.size()].position.cx(),
-                position.cy());
-            vertex.position.y() = position.cy();
+        occlusionCulledTriangleCount += culledTriangleCount;
+        occlusionCulledBlockCount += culledBlockCount;
+        tileRasterTimes[tile] = timer.getMilliseconds();
+        timer.restart();
 
-            double alpha = (position.cy() - top) / (bottom - top);
-            alpha = std::min(std::max(alpha, 0.0), 1.0);
+        // Only pixels covered by the current draw are shaded, the others keep the color of earlier draws
+        for (int64_t y = top; y <= bottom; ++y) {
+            const size_t *primitives = &primitiveBuffer[y * viewWidth];
+
+            for (int64_t runLeft = left; runLeft <= right; ++runLeft) {
+                if (primitives[runLeft] == SIZE_MAX) {
+                    continue;
+                }
 
-            for (size_t i = 0; i < 4; ++i) {
-                vertex.color[i] = primitive[topIndex].color.c(i) + alpha * (primitive[bottomIndex].color.c(i) - primitive[topIndex].color.c(i));
+                int64_t runRight = runLeft;
+
+                while (runRight < right && primitives[runRight + 1] != SIZE_MAX) {
+                    ++runRight;
+                }
+
+                float tilePixels[4 * tileSize];
+                float *pixels = floatImageEnabled ? &floatImage[4 * (y * viewWidth + runLeft)] : tilePixels;
+                shadeRow(y, runLeft, runRight, primitives + runLeft, pixels);
+                packPixels(pixels, &image[4 * (y * viewWidth + runLeft)], runRight - runLeft + 1);
+                tileShadedPixelCount += runRight - runLeft + 1;
+                runLeft = runRight;
             }
+        }
+
+        tileShadeTimes[tile] = timer.getMilliseconds();
+        fragmentCount += tileFragmentCount;
+        shadedPixelCount += tileShadedPixelCount;
+    });
 
-            referenceVertexes.push_back(vertex);
+    // Tiles are shaded on several threads, so shading gets the part of the wall time of the tiles which the threads
+    // spent shading
+    const double tileTime = tileTimer.getMilliseconds();
+    double threadTime = 0, threadShadeTime = 0;
+
+    for (size_t tile = 0; tile < tileCountX * tileCountY; ++tile) {
+        threadTime += tileRasterTimes[tile] + tileShadeTimes[tile];
+        threadShadeTime += tileShadeTimes[tile];
+    }
+
+    occlusionStatistics.binnedTriangleCount += tileBins.size();
+    occlusionStatistics.culledTriangleCount += occlusionCulledTriangleCount;
+    occlusionStatistics.culledBlockCount += occlusionCulledBlockCount;
+    renderStatistics.fragmentCount += fragmentCount;
+    renderStatistics.shadedPixelCount += shadedPixelCount;
+    renderStatistics.shadeTime += threadTime > 0 ? tileTime * threadShadeTime / threadTime : 0;
+}
+
+void RenderEngine::lightVertexes(bool isLightCacheEnabled) {
+    const size_t chunkSize = 1024;
+    const size_t revision = lightEngine.getRevision();
+
+    if (lightEngine.getViewTranslation() != lightCacheViewTranslation) {
+        lightCacheViewTranslation = lightEngine.getViewTranslation();
+        ++lightCacheViewRevision;
+    }
+
+    size_t cacheSize = lightCache.size();
+
+    for (const auto& vertex : vertexArray) {
+        if (isLightCacheEnabled && vertex.index != SIZE_MAX) {
+            cacheSize = std::max(cacheSize, vertex.index + 1);
         }
     }
-    
-    if (referenceVertexes.size() != 2) {
-        if (referenceVertexes.empty()) {
-            return primitive[0].color;
-        } else {
-            return referenceVertexes[0].color;
+
+    lightCache.resize(cacheSize);
+    vertexLights.resize(vertexArray.size());
+
+    threadPool.run((vertexArray.size() + chunkSize - 1) / chunkSize, [&](size_t chunk) {
+        const size_t first = chunk * chunkSize;
+        const size_t last = std::min(first + chunkSize, vertexArray.size());
+        std::vector<size_t> uncachedVertexes, viewIndependentVertexes, specularVertexes;
+
+        for (size_t i = first; i < last; ++i) {
+            const Vertex &vertex = vertexArray[i];
+
+            if (!isLightCacheEnabled || vertex.index == SIZE_MAX) {
+                uncachedVertexes.push_back(i);
+                continue;
+            }
+
+            lightCacheEntry &entry = lightCache[vertex.index];
+
+            if (entry.revision != revision || entry.origin != vertex.origin || entry.normal != vertex.normal) {
+                entry.origin = vertex.origin;
+                entry.normal = vertex.normal;
+                entry.revision = revision;
+                entry.viewRevision = SIZE_MAX;
+                viewIndependentVertexes.push_back(i);
+            }
+
+            if (entry.viewRevision != lightCacheViewRevision) {
+                specularVertexes.push_back(i);
+            }
+        }
+
+        lightVertexBatch(&LightEngine::getLights, uncachedVertexes, [&](size_t i, const Vector4 &light) {
+            vertexLights[i] = light;
+        });
+
+        lightVertexBatch(&LightEngine::getViewIndependentLights, viewIndependentVertexes, [&](size_t i, const Vector4 &light) {
+            lightCache[vertexArray[i].index].viewIndependentLight = light;
+        });
+
+        lightVertexBatch(&LightEngine::getSpecularLights, specularVertexes, [&](size_t i, const Vector4 &specularLight) {
+            lightCacheEntry &entry = lightCache[vertexArray[i].index];
+
+            for (size_t k = 0; k < 4; ++k) {
+                entry.light[k] = std::min(entry.viewIndependentLight.c(k) + specularLight.c(k), Real(1));
+            }
+
+            entry.viewRevision = lightCacheViewRevision;
+        });
+
+        for (size_t i = first; i < last; ++i) {
+            if (isLightCacheEnabled && vertexArray[i].index != SIZE_MAX) {
+                vertexLights[i] = lightCache[vertexArray[i].index].light;
+            }
         }
+    });
+}
+
+template <typename Store>
+void RenderEngine::lightVertexBatch(batchLightFunction function, const std::vector<size_t> &vertexes, Store store) const {
+    if (vertexes.empty()) {
+        return;
     }
 
-    auto leftIndex = 0;
-    auto rightIndex = 1;
-    auto left = referenceVertexes[leftIndex].position.cx();
-    auto right = referenceVertexes[rightIndex].position.cx();
+    const size_t count = vertexes.size();
+    std::vector<float> values(10 * count);
+    float *positions[3], *normals[3], *lights[4];
 
-    if (left > right) {
-        std::swap(left, right);
-        std::swap(leftIndex, rightIndex);
+    for (size_t j = 0; j < 3; ++j) {
+        positions[j] = &values[j * count];
+        normals[j] = &values[(3 + j) * count];
     }
 
-    double alpha = (position.cx() - left) / (right - left);
-    alpha = std::min(std::max(alpha, 0.0), 1.0);
+    for (size_t k = 0; k < 4; ++k) {
+        lights[k] = &values[(6 + k) * count];
+    }
 
-    for (size_t i = 0; i < 4; ++i) {
-        gradientColor[i] = referenceVertexes[leftIndex].color.c(i) + alpha * (referenceVertexes[rightIndex].color.c(i) - referenceVertexes[leftIndex].color.c(i));
+    for (size_t i = 0; i < count; ++i) {
+        const Vertex &vertex = vertexArray[vertexes[i]];
+
+        for (size_t j = 0; j < 3; ++j) {
+            positions[j][i] = static_cast<float>(vertex.origin.c(j));
+            normals[j][i] = static_cast<float>(vertex.normal.c(j));
+        }
     }
 
-    return gradientColor;
-}
+    (lightEngine.*function)(count, positions, normals, lights);
 
-Vector4 RenderEngine::getLight(const std::vector<Vertex> &primitive, Vector4 position) {
-    std::vector<Vertex> primitiveLight;
-    
-    for (size_t i = 0; i < primitive.size(); ++i) {
-        Vertex vertex;
-        vertex.position = primitive[i].position;
-        vertex.color = lightEngine.getLight(primitive[i].origin, primitive[i].normal);
-        primitiveLight.push_back(vertex);
+    for (size_t i = 0; i < count; ++i) {
+        store(vertexes[i], Vector4(lights[0][i], lights[1][i], lights[2][i], lights[3][i]));
     }
+}
+
+void RenderEngine::setupGradients() {
+    const size_t primitiveCount = indexArray.size() / 3;
+    const size_t chunkSize = 1024;
+
+    gradients.resize(primitiveCount);
+
+    threadPool.run((primitiveCount + chunkSize - 1) / chunkSize, [&](size_t chunk) {
+        for (size_t primitive = chunk * chunkSize; primitive < std::min((chunk + 1) * chunkSize, primitiveCount); ++primitive) {
+            const size_t *indexes = &indexArray[3 * primitive];
+            const Vertex *v[3] = { &vertexArray[indexes[0]], &vertexArray[indexes[1]], &vertexArray[indexes[2]] };
+            gradient &g = gradients[primitive];
+            Real values[3][8];
+
+            for (size_t j = 0; j < 3; ++j) {
+                for (size_t k = 0; k < 4; ++k) {
+                    values[j][k] = v[j]->color.c(k);
+                    values[j][4 + k] = vertexLights[indexes[j]].c(k);
+                }
+            }
+
+            const Real x1 = v[1]->position.cx() - v[0]->position.cx();
+            const Real y1 = v[1]->position.cy() - v[0]->position.cy();
+            const Real x2 = v[2]->position.cx() - v[0]->position.cx();
+            const Real y2 = v[2]->position.cy() - v[0]->position.cy();
+            const Real area = x1 * y2 - x2 * y1;
+
+            for (size_t k = 0; k < 8; ++k) {
+                // Degenerate primitives take the attributes of their first vertex
+                if (std::abs(area) < 1e-12) {
+                    g.stepX[k] = 0.0;
+                    g.stepY[k] = 0.0;
+                } else {
+                    const Real a1 = values[1][k] - values[0][k];
+                    const Real a2 = values[2][k] - values[0][k];
+                    g.stepX[k] = (a1 * y2 - a2 * y1) / area;
+                    g.stepY[k] = (a2 * x1 - a1 * x2) / area;
+                }
 
-    return getGradientColor(primitiveLight, position);
+                g.origin[k] = values[0][k] - g.stepX[k] * v[0]->position.cx() - g.stepY[k] * v[0]->position.cy();
+            }
+        }
+    });
+}
+
+void RenderEngine::shadeRow(size_t y, size_t left, size_t right, const size_t *primitives, float *pixels) {
+    for (size_t x = left; x <= right;) {
+        const size_t primitive = primitives[x - left];
+
+        if (primitive == SIZE_MAX) {
+            for (size_t k = 0; k < 4; ++k) {
+                pixels[4 * (x - left) + k] = backgroundColor.c(k);
+            }
+
+            ++x;
+            continue;
+        }
+
+        // Attributes are evaluated at the start of a run of pixels of the same primitive and stepped from there
+        const gradient &g = gradients[primitive];
+        Real values[8];
+
+        for (size_t k = 0; k < 8; ++k) {
+            values[k] = g.origin[k] + g.stepX[k] * x + g.stepY[k] * y;
+        }
+
+        do {
+            for (size_t k = 0; k < 4; ++k) {
+                pixels[4 * (x - left) + k] = std::min(std::max(values[k] * values[4 + k], Real(0)), Real(1));
+            }
+
+            for (size_t k = 0; k < 8; ++k) {
+                values[k] += g.stepX[k];
+            }
+
+            ++x;
+        } while (x <= right && primitives[x - left] == primitive);
+    }
 }
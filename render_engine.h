@@ -1,10 +1,35 @@
 #ifndef RENDER_ENGINE_H
 #define RENDER_ENGINE_H
 
+#include <cstdint>
 #include <vector>
 #include "light_engine.h"
+#include "stage_timer.h"
+#include "thread_pool.h"
 #include "vertex.h"
 
+enum RasterizationModes {
+    Scanline,
+    HalfSpace
+};
+
+// Hierarchical depth culling counters of the half-space rasterizer
+struct OcclusionStatistics {
+    size_t binnedTriangleCount = 0; // Triangle and tile pairs
+    size_t culledTriangleCount = 0; // Triangle and tile pairs rejected against the farthest depth of the tile
+    size_t culledBlockCount = 0; // Blocks of a triangle rejected against the farthest depth of the block
+};
+
+// Work and wall time in milliseconds of the stages of the last frame, a frame drawn in batches adds up all of them
+struct RenderStatistics {
+    size_t triangleCount = 0;
+    size_t fragmentCount = 0; // Pixels covered by a triangle, before the depth test picks the nearest one
+    size_t shadedPixelCount = 0;
+    double lightTime = 0; // Lighting of vertexes
+    double rasterTime = 0; // Clearing, binning, depth tests and the depth pyramid
+    double shadeTime = 0; // Gradients, interpolation of color and light and packing of pixels
+};
+
 class RenderEngine {
 
 public:
@@ -13,32 +38,97 @@ public:
     
     LightEngine& getLightEngine();
 
-    double getViewWidth() const;
-    double getViewHeight() const;
+    Real getViewWidth() const;
+    Real getViewHeight() const;
     void setViewSize(size_t viewWidth, size_t viewHeight);
 
     Vector4 getBackgroundColor() const;
     void setBackgroundColor(Vector4 backgroundColor);
 
+    RasterizationModes getRasterizationMode() const;
+    void setRasterizationMode(RasterizationModes rasterizationMode);
+
+    size_t getThreadCount() const;
+    void setThreadCount(size_t threadCount);
+
+    // Every 3 consecutive indexes form a primitive, without indexes every 3 consecutive vertexes do
     void setVertexArray(const std::vector<Vertex> &vertexArray);
+    void setVertexArray(const std::vector<Vertex> &vertexArray, const std::vector<size_t> &indexArray);
+
+    // The float image keeps unquantized RGBA values next to the packed RGBA8 image
+    bool isFloatImageEnabled() const;
+    void setFloatImageEnabled(bool floatImageEnabled);
 
     void run();
-    const std::vector<Vector4>& getImage();
+
+    // Draws a frame in batches which share the depth buffer, so that only one batch of a model has to be kept
+    // in memory. Batches always use the half-space rasterizer and bypass the light cache. Primitives of later
+    // batches lose depth ties to the ones of earlier batches, so the frame matches one drawn at once.
+    void beginFrame();
+    void drawVertexArray(const std::vector<Vertex> &vertexArray, const std::vector<size_t> &indexArray);
+
+    const std::vector<uint8_t>& getImage() const;
+    const std::vector<float>& getFloatImage() const;
+    const OcclusionStatistics& getOcclusionStatistics() const;
+    const RenderStatistics& getRenderStatistics() const;
 
 private:
 
-    Vector4 getGradientColor(const std::vector<Vertex> &primitive, Vector4 position);
-    Vector4 getLight(const std::vector<Vertex> &primitive, Vector4 position);
+    void clearFrame();
+    void rasterizeScanline();
+    void rasterizeHalfSpace();
+    void lightVertexes(bool isLightCacheEnabled);
+
+    // Lights the listed vertexes with one of the LightEngine batch functions and passes each result to store
+    typedef void (LightEngine::*batchLightFunction)(size_t, const float *const[3], const float *const[3], float *const[4]) const;
+    template <typename Store>
+    void lightVertexBatch(batchLightFunction function, const std::vector<size_t> &vertexes, Store store) const;
+
+    void setupGradients();
+    void shadeRow(size_t y, size_t left, size_t right, const size_t *primitives, float *pixels);
 
 private:
 
+    // Light of a model vertex kept between frames, the view independent part stays valid until
+    // lights or material change and the full light until the view translation changes
+    struct lightCacheEntry {
+        Vector4 origin;
+        Vector4 normal;
+        Vector4 viewIndependentLight;
+        Vector4 light;
+        size_t revision = SIZE_MAX;
+        size_t viewRevision = SIZE_MAX;
+    };
+
+    // Color (0-3) and light (4-7) of a primitive at (x, y) equal origin + x * stepX + y * stepY
+    struct gradient {
+        Real origin[8];
+        Real stepX[8];
+        Real stepY[8];
+    };
+
     LightEngine lightEngine;
+    ThreadPool threadPool;
 
     size_t viewWidth, viewHeight;
     Vector4 backgroundColor;
+    RasterizationModes rasterizationMode;
+    bool floatImageEnabled;
+    OcclusionStatistics occlusionStatistics;
+    RenderStatistics renderStatistics;
 
     std::vector<Vertex> vertexArray;
-    std::vector<Vector4> image;
+    std::vector<size_t> indexArray;
+    std::vector<Vector4> vertexLights;
+    std::vector<lightCacheEntry> lightCache;
+    Vector4 lightCacheViewTranslation;
+    size_t lightCacheViewRevision;
+    std::vector<gradient> gradients;
+    std::vector<uint8_t> image;
+    std::vector<float> floatImage;
+    std::vector<Real> depthBuffer;
+    std::vector<size_t> primitiveBuffer;
+    std::vector<Real> blockDepthBuffer;
 
 };
 
@@ -2,7 +2,7 @@
 #include <fstream>
 #include "shapes.h"
 
-std::vector<Vertex> Shapes::generateSphere(double radius, size_t ringCount, size_t edgeCount, Vector4 origin, Vector4 color) {
+std::vector<Vertex> Shapes::generateSphere(Real radius, size_t ringCount, size_t edgeCount, Vector4 origin, Vector4 color) {
     std::vector<Vertex> vertexes;
     
     if (ringCount < 6 || edgeCount < 4) {
@@ -10,17 +10,17 @@ std::vector<Vertex> Shapes::generateSphere(double radius, size_t ringCount, size
     }
     
     for (size_t half = 0; half < 2; ++half) {
-        double halfSign = (half == 0 ? 1.0 : -1.0);
+        Real halfSign = (half == 0 ? 1.0 : -1.0);
 
         std::vector< std::vector<Vertex> > rings;
         rings.resize(ringCount / 2);
 
         for (size_t i = 0; i < ringCount / 2; ++i) {
-            double ringAlpha = M_PI * i / (double) (ringCount / 2 - 1);
-            double ringRadius = radius * cos(M_PI - ringAlpha);
+            Real ringAlpha = M_PI * i / (Real) (ringCount / 2 - 1);
+            Real ringRadius = radius * cos(M_PI - ringAlpha);
 
             for (size_t j = 0; (j < edgeCount) || (i == ringCount / 2 - 1 && j < 1); ++j) {
-                double angle = 2.0 * M_PI * j / (double) (edgeCount - 1);
+                Real angle = 2.0 * M_PI * j / (Real) (edgeCount - 1);
                 auto translation = Vector4(ringRadius * sin(angle), halfSign * radius * sin(ringAlpha), ringRadius * cos(angle));
                 Vertex vertex;
                 vertex.origin = vertex.position = Vector4(origin.cx() + translation.cx(), origin.cy() + translation.cy(), origin.cz() + translation.cz(), 1.0);
@@ -31,14 +31,22 @@ std::vector<Vertex> Shapes::generateSphere(double radius, size_t ringCount, size
             }
         }
 
+        // The lower half is mirrored, so its triangles are flipped to keep them counter clockwise seen from outside
+        const size_t second = (half == 0 ? 1 : 2);
+        const size_t third = (half == 0 ? 2 : 1);
+
         for (size_t i = 0; i < ringCount / 2 - 1; ++i) {
             for (size_t j = 0; j < edgeCount - 1; ++j) {
-                vertexes.push_back(rings[i  ][j     % edgeCount]);
-                vertexes.push_back(rings[i  ][(j+1) % edgeCount]);
-                vertexes.push_back(rings[i+1][j     % rings[i+1].size()]);
-                vertexes.push_back(rings[i  ][(j+1) % edgeCount]);
-                vertexes.push_back(rings[i+1][(j+1) % rings[i+1].size()]);
-                vertexes.push_back(rings[i+1][j     % rings[i+1].size()]);
+                const Vertex triangles[2][3] = {
+                    {rings[i][j % edgeCount], rings[i][(j+1) % edgeCount], rings[i+1][j % rings[i+1].size()]},
+                    {rings[i][(j+1) % edgeCount], rings[i+1][(j+1) % rings[i+1].size()], rings[i+1][j % rings[i+1].size()]}
+                };
+
+                for (const auto& triangle : triangles) {
+                    vertexes.push_back(triangle[0]);
+                    vertexes.push_back(triangle[second]);
+                    vertexes.push_back(triangle[third]);
+                }
             }
         }
     }
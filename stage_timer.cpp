@@ -0,0 +1,13 @@
+#include "stage_timer.h"
+
+StageTimer::StageTimer() {
+    restart();
+}
+
+void StageTimer::restart() {
+    start = std::chrono::steady_clock::now();
+}
+
+double StageTimer::getMilliseconds() const {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
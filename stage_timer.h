@@ -0,0 +1,22 @@
+#ifndef STAGE_TIMER_H
+#define STAGE_TIMER_H
+
+#include <chrono>
+
+// Measures the wall time of a stage of a frame from the moment it was started
+class StageTimer {
+
+public:
+
+    StageTimer();
+
+    void restart();
+    double getMilliseconds() const;
+
+private:
+
+    std::chrono::steady_clock::time_point start;
+
+};
+
+#endif
@@ -0,0 +1,277 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include "text_scanner.h"
+
+static bool isBlank(char c) {
+    return c == ' ' || c == '\t' || c == '\v' || c == '\f' || c == '\r' || c == '\n';
+}
+
+// Powers of ten exactly representable in both precisions, a decimal mantissa of at most maxExactMantissa
+// multiplied or divided by one of them is rounded once and so equals the correctly rounded value
+const double exactPowersOfTen[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+template <typename T>
+struct scalarLimits;
+
+template <>
+struct scalarLimits<double> {
+    static const uint64_t maxExactMantissa = 1ull << 53;
+    static const int maxExactExponent = 22;
+    static double convert(const char *text, char **textEnd) { return std::strtod(text, textEnd); }
+};
+
+template <>
+struct scalarLimits<float> {
+    static const uint64_t maxExactMantissa = 1ull << 24;
+    static const int maxExactExponent = 10;
+    static float convert(const char *text, char **textEnd) { return std::strtof(text, textEnd); }
+};
+
+// Accepts [+-]digits[.digits][(e|E)[+-]digits] with at least one mantissa digit, like std::num_get, and stops at
+// the first character which cannot continue the number. Values which overflow are rejected, as streams do.
+template <typename T>
+static bool scanNumber(const char *&text, const char *end, T &value) {
+    const char *start = text;
+    const char *current = text;
+    bool isNegative = false;
+    uint64_t mantissa = 0;
+    size_t significantDigitCount = 0;
+    size_t mantissaDigitCount = 0;
+    long exponent = 0;
+
+    if (current != end && (*current == '+' || *current == '-')) {
+        isNegative = *current == '-';
+        ++current;
+    }
+
+    for (; current != end && *current >= '0' && *current <= '9'; ++current, ++mantissaDigitCount) {
+        if (significantDigitCount > 0 || *current != '0') {
+            if (++significantDigitCount <= 19) {
+                mantissa = mantissa * 10 + static_cast<uint64_t>(*current - '0');
+            } else {
+                ++exponent;
+            }
+        }
+    }
+
+    if (current != end && *current == '.') {
+        for (++current; current != end && *current >= '0' && *current <= '9'; ++current, ++mantissaDigitCount) {
+            if (significantDigitCount > 0 || *current != '0') {
+                if (++significantDigitCount <= 19) {
+                    mantissa = mantissa * 10 + static_cast<uint64_t>(*current - '0');
+                    --exponent;
+                }
+            } else {
+                --exponent;
+            }
+        }
+    }
+
+    if (mantissaDigitCount == 0) {
+        return false;
+    }
+
+    if (current != end && (*current == 'e' || *current == 'E')) {
+        bool isExponentNegative = false;
+        long explicitExponent = 0;
+        const char *exponentDigits;
+
+        ++current;
+
+        if (current != end && (*current == '+' || *current == '-')) {
+            isExponentNegative = *current == '-';
+            ++current;
+        }
+
+        for (exponentDigits = current; current != end && *current >= '0' && *current <= '9'; ++current) {
+            explicitExponent = std::min(explicitExponent * 10 + (*current - '0'), 100000L);
+        }
+
+        if (current == exponentDigits) {
+            return false;
+        }
+
+        exponent += isExponentNegative ? -explicitExponent : explicitExponent;
+    }
+
+    text = current;
+
+    if (mantissa == 0) {
+        value = isNegative ? -T(0) : T(0);
+        return true;
+    }
+
+    if (significantDigitCount <= 19 && mantissa <= scalarLimits<T>::maxExactMantissa &&
+        std::labs(exponent) <= scalarLimits<T>::maxExactExponent) {
+        const T power = static_cast<T>(exactPowersOfTen[std::labs(exponent)]);
+        value = exponent < 0 ? static_cast<T>(mantissa) / power : static_cast<T>(mantissa) * power;
+        value = isNegative ? -value : value;
+        return true;
+    }
+
+    // Remaining values are rounded by the C library from a terminated copy of the number
+    char buffer[64];
+    const size_t length = static_cast<size_t>(current - start);
+    std::string longBuffer;
+    char *textEnd;
+    const char *terminated = buffer;
+
+    if (length < sizeof(buffer)) {
+        std::memcpy(buffer, start, length);
+        buffer[length] = 0;
+    } else {
+        longBuffer.assign(start, length);
+        terminated = longBuffer.c_str();
+    }
+
+    value = scalarLimits<T>::convert(terminated, &textEnd);
+
+    return textEnd == terminated + length && !std::isinf(value);
+}
+
+TextScanner::TextScanner(const char *begin, const char *end) {
+    cursor = begin;
+    this->end = end;
+    lineCursor = begin;
+    lineEnd = begin;
+    lineNumber = 0;
+    failed = true;
+}
+
+bool TextScanner::nextLine() {
+    while (cursor != end) {
+        const char *lineBegin = cursor;
+        const char *newLine = static_cast<const char*>(std::memchr(cursor, '\n', end - cursor));
+
+        lineEnd = newLine != nullptr ? newLine : end;
+        cursor = newLine != nullptr ? newLine + 1 : end;
+        ++lineNumber;
+
+        while (lineBegin != lineEnd && isBlank(*lineBegin)) {
+            ++lineBegin;
+        }
+
+        while (lineEnd != lineBegin && isBlank(lineEnd[-1])) {
+            --lineEnd;
+        }
+
+        // Empty line or comment
+        if (lineBegin == lineEnd || *lineBegin == '#') {
+            continue;
+        }
+
+        lineCursor = lineBegin;
+        failed = false;
+
+        return true;
+    }
+
+    lineCursor = end;
+    lineEnd = end;
+    failed = true;
+
+    return false;
+}
+
+size_t TextScanner::getLineNumber() const {
+    return lineNumber;
+}
+
+const char* TextScanner::getCursor() const {
+    return cursor;
+}
+
+bool TextScanner::read(Real &value) {
+    if (failed) {
+        return false;
+    }
+
+    while (lineCursor != lineEnd && isBlank(*lineCursor)) {
+        ++lineCursor;
+    }
+
+    failed = !scanNumber(lineCursor, lineEnd, value);
+
+    return !failed;
+}
+
+bool TextScanner::readWord(std::string &word) {
+    if (failed) {
+        return false;
+    }
+
+    while (lineCursor != lineEnd && isBlank(*lineCursor)) {
+        ++lineCursor;
+    }
+
+    const char *wordBegin = lineCursor;
+
+    while (lineCursor != lineEnd && !isBlank(*lineCursor)) {
+        ++lineCursor;
+    }
+
+    word.assign(wordBegin, lineCursor);
+    failed = word.empty();
+
+    return !failed;
+}
+
+bool TextScanner::readRest(std::string &text) {
+    if (failed) {
+        return false;
+    }
+
+    while (lineCursor != lineEnd && isBlank(*lineCursor)) {
+        ++lineCursor;
+    }
+
+    text.assign(lineCursor, lineEnd);
+    lineCursor = lineEnd;
+    failed = text.empty();
+
+    return !failed;
+}
+
+bool TextScanner::fail() const {
+    return failed;
+}
+
+bool TextScanner::readVertex(Vertex &vertex) {
+    read(vertex.position.x());
+    read(vertex.position.y());
+    read(vertex.position.z());
+    vertex.position.w() = 1.0;
+
+    if (fail()) {
+        return false;
+    }
+
+    vertex.origin = vertex.position;
+
+    read(vertex.color.x());
+    read(vertex.color.y());
+    read(vertex.color.z());
+    vertex.color.w() = 1.0;
+
+    if (fail()) {
+        vertex.color = Vector4(1.0, 1.0, 1.0, 1.0);
+    }
+
+    read(vertex.normal.x());
+    read(vertex.normal.y());
+    read(vertex.normal.z());
+    vertex.normal.w() = 0.0;
+
+    if (fail()) {
+        vertex.normal = Vector4(0.0, 0.0, 0.0, 0.0);
+    }
+
+    return true;
+}
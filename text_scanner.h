@@ -0,0 +1,48 @@
+#ifndef TEXT_SCANNER_H
+#define TEXT_SCANNER_H
+
+#include <cstddef>
+#include <string>
+#include "vertex.h"
+
+// Reads the line based text formats of models, scenes, materials and light sources. Lines end with LF, whitespace
+// around them is ignored and lines which are then empty or start with # are skipped. Numbers are read without
+// allocating and the way std::istream reads them, so every file keeps the meaning it had with stream based parsing.
+class TextScanner {
+
+public:
+
+    TextScanner(const char *begin, const char *end);
+
+    // Moves to the next line holding values, returns false when the range ends
+    bool nextLine();
+
+    // Number of the current line counted from 1, once the range ends it is the number of lines in the range
+    size_t getLineNumber() const;
+
+    // Start of the line following the current one
+    const char* getCursor() const;
+
+    // Reads the next number of the current line, after a failure every later read of the line fails as well
+    bool read(Real &value);
+    bool fail() const;
+
+    // Reads the next run of non whitespace characters, or everything up to the end of the line
+    bool readWord(std::string &word);
+    bool readRest(std::string &text);
+
+    // Reads a model line, which is a position followed by an optional color and an optional normal
+    bool readVertex(Vertex &vertex);
+
+private:
+
+    const char *cursor;
+    const char *end;
+    const char *lineCursor;
+    const char *lineEnd;
+    size_t lineNumber;
+    bool failed;
+
+};
+
+#endif
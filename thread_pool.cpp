@@ -0,0 +1,115 @@
+#include <algorithm>
+#include "thread_pool.h"
+
+ThreadPool::ThreadPool(size_t threadCount) {
+    isStopping = false;
+    generation = 0;
+    activeWorkerCount = 0;
+    task = nullptr;
+    taskCount = 0;
+    nextTask = 0;
+    setThreadCount(threadCount);
+}
+
+ThreadPool::~ThreadPool() {
+    stopWorkers();
+}
+
+size_t ThreadPool::getThreadCount() const {
+    return workers.size() + 1;
+}
+
+void ThreadPool::setThreadCount(size_t threadCount) {
+    if (threadCount == 0) {
+        threadCount = std::max(std::thread::hardware_concurrency(), 1u);
+    }
+
+    if (threadCount == getThreadCount()) {
+        return;
+    }
+
+    stopWorkers();
+    startWorkers(threadCount - 1);
+}
+
+void ThreadPool::run(size_t taskCount, const std::function<void(size_t)> &task) {
+    if (workers.empty() || taskCount < 2) {
+        for (size_t i = 0; i < taskCount; ++i) {
+            task(i);
+        }
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        this->task = &task;
+        this->taskCount = taskCount;
+        nextTask = 0;
+        activeWorkerCount = workers.size();
+        ++generation;
+    }
+
+    wakeCondition.notify_all();
+    runTasks();
+
+    std::unique_lock<std::mutex> lock(mutex);
+    doneCondition.wait(lock, [this]() {
+        return activeWorkerCount == 0;
+    });
+    this->task = nullptr;
+}
+
+void ThreadPool::startWorkers(size_t workerCount) {
+    isStopping = false;
+
+    for (size_t i = 0; i < workerCount; ++i) {
+        workers.emplace_back(&ThreadPool::work, this, generation);
+    }
+}
+
+void ThreadPool::stopWorkers() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        isStopping = true;
+    }
+
+    wakeCondition.notify_all();
+
+    for (auto& worker : workers) {
+        worker.join();
+    }
+
+    workers.clear();
+}
+
+void ThreadPool::work(size_t seenGeneration) {
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wakeCondition.wait(lock, [this, seenGeneration]() {
+                return isStopping || generation != seenGeneration;
+            });
+
+            if (isStopping) {
+                return;
+            }
+
+            seenGeneration = generation;
+        }
+
+        runTasks();
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (--activeWorkerCount == 0) {
+                doneCondition.notify_one();
+            }
+        }
+    }
+}
+
+void ThreadPool::runTasks() {
+    for (size_t i = nextTask++; i < taskCount; i = nextTask++) {
+        (*task)(i);
+    }
+}
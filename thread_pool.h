@@ -0,0 +1,51 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class ThreadPool {
+
+public:
+
+    ThreadPool(size_t threadCount = 0);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool &other) = delete;
+    ThreadPool& operator=(const ThreadPool &other) = delete;
+
+    size_t getThreadCount() const;
+    void setThreadCount(size_t threadCount);
+
+    // Calls task(i) for every i from 0 to taskCount - 1 and returns when all calls are done.
+    // The calling thread takes part in the work. Tasks must not call run on the same pool.
+    void run(size_t taskCount, const std::function<void(size_t)> &task);
+
+private:
+
+    void startWorkers(size_t workerCount);
+    void stopWorkers();
+    void work(size_t seenGeneration);
+    void runTasks();
+
+private:
+
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable wakeCondition;
+    std::condition_variable doneCondition;
+    bool isStopping;
+    size_t generation;
+    size_t activeWorkerCount;
+
+    const std::function<void(size_t)> *task;
+    size_t taskCount;
+    std::atomic<size_t> nextTask;
+
+};
+
+#endif
@@ -0,0 +1,740 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "../clip_engine.h"
+#include "../image_writer.h"
+#include "../render_engine.h"
+#include "../shapes.h"
+#include "../transform.h"
+#include "../transform_engine.h"
+
+// Scenes cover the same square of the ground whatever their triangle count, so larger scenes are made of more and
+// smaller objects. The camera looks at the square from above its near edge.
+const Real sceneSize = 20;
+const Real sceneViewTranslation[3] = { 0, -9, 19 };
+const Real sceneViewAngle = -PI / 6;
+const size_t sceneTriangleCounts[] = { 1000, 10000, 100000, 1000000, 10000000 };
+
+// Scenes of ten million triangles take more than 5 GB of memory, so they are only benched when asked for
+const size_t defaultMaximumTriangleCount = 1000000;
+
+// Resolutions and light counts are swept on the scene of this many triangles, the other cases use the defaults
+const size_t sweptTriangleCount = 100000;
+const size_t viewSizes[][2] = { { 320, 240 }, { 1280, 720 }, { 1920, 1080 } };
+const size_t defaultViewSize = 1;
+const size_t lightCounts[] = { 1, 8, 64 };
+
+// Cases with several lights are also run with lights culled where they add less than one step of 8-bit output
+const Real lightCullingThreshold = Real(1) / 255;
+
+// Clipping reads a vertex array of every triangle of the scene, which is built only for the smaller scenes
+const size_t clipMaximumTriangleCount = 1000000;
+const size_t lightPointCount = 1 << 16;
+const size_t matrixProductCount = 1 << 20;
+const size_t matrixVectorCount = 1 << 20;
+
+// Every measurement runs once to warm up and then repeats until it took long enough
+const double minimumMeasurementTime = 250;
+const size_t minimumRepetitionCount = 3;
+
+struct measurement {
+    size_t repetitionCount;
+    double mean;
+    double minimum;
+};
+
+// A stage measured in one case, fields hold JSON values in the order they are written
+struct benchResult {
+    std::string stage;
+    std::vector<std::pair<std::string, std::string>> fields;
+    std::string checksumName;
+    std::string checksum;
+};
+
+struct benchInstance {
+    Real x, y, z;
+    Real angle;
+    Real scale;
+};
+
+struct benchScene {
+    std::string name;
+    std::vector<benchInstance> instances;
+};
+
+struct benchRasterizer {
+    RasterizationModes mode;
+    const char *name;
+};
+
+// The scanline rasterizer is the single threaded reference, the half-space one is tiled, parallel and culls occluded
+// triangles, so both are benched and checked
+const benchRasterizer rasterizers[] = { { RasterizationModes::Scanline, "scanline" }, { RasterizationModes::HalfSpace, "half-space" } };
+
+// Deterministic pseudo random numbers, so that every run generates the same scenes
+class benchRandom {
+
+public:
+
+    benchRandom(uint32_t seed) : state(seed) {}
+
+    Real getReal(Real minimum, Real maximum) {
+        state = state * 1664525 + 1013904223;
+        return minimum + (maximum - minimum) * static_cast<Real>(state >> 8) / static_cast<Real>(1 << 24);
+    }
+
+private:
+
+    uint32_t state;
+
+};
+
+bool parseOptions(int argc, char *argv[], size_t &maximumTriangleCount, std::string &saveGoldenFilePath,
+    std::string &checkGoldenFilePath, std::string &imageDirectoryPath);
+template <typename Function>
+measurement measure(Function run);
+std::vector<Vertex> generateCityBlock();
+void addQuad(const Vector4 corners[4], Vector4 normal, Vector4 color, std::vector<Vertex> &vertexes);
+bool generateScene(const std::string &name, size_t triangleCount, const std::string &meshFilePath, TransformEngine &transformEngine, benchScene &scene);
+std::vector<Vertex> getClipSpaceTriangles(const benchScene &scene, const TransformEngine &transformEngine);
+std::vector<LightSource> generateLightSources(size_t lightCount);
+void setupView(TransformEngine &transformEngine, RenderEngine &renderEngine, size_t width, size_t height, size_t lightCount);
+void benchMatrixProducts(std::vector<benchResult> &results);
+void benchLighting(std::vector<benchResult> &results);
+void benchRender(const benchScene &scene, size_t triangleCount, TransformEngine &transformEngine, size_t width, size_t height,
+    size_t lightCount, Real lightCullingThreshold, const std::string &imageDirectoryPath, std::vector<benchResult> &results);
+void addMeasurement(const measurement &time, benchResult &result);
+std::string getChecksum(const std::vector<uint8_t> &image);
+std::string toString(double value);
+void printResult(const benchResult &result);
+bool saveResults(const std::string &filePath, const std::vector<benchResult> &results);
+bool loadGolden(const std::string &filePath, std::map<std::string, std::string> &checksums);
+bool saveGolden(const std::string &filePath, const std::vector<benchResult> &results);
+void printUsage();
+
+// Times the stages of the pipeline separately on procedural scenes from a thousand to ten million triangles and
+// saves the results as JSON, so that they can be compared between commits. Checksums of the rendered images can be
+// saved as golden ones and checked later, to catch optimizations which change the output.
+int main(int argc, char *argv[]) {
+    size_t maximumTriangleCount = defaultMaximumTriangleCount;
+    std::string saveGoldenFilePath, checkGoldenFilePath, imageDirectoryPath;
+    std::vector<benchResult> results;
+
+    if (argc < 2 || !parseOptions(argc, argv, maximumTriangleCount, saveGoldenFilePath, checkGoldenFilePath, imageDirectoryPath)) {
+        printUsage();
+        return 1;
+    }
+
+    const std::string resultsFilePath = argv[1];
+
+    benchMatrixProducts(results);
+    benchLighting(results);
+
+    for (const std::string sceneName : { "spheres", "city" }) {
+        for (size_t triangleCount : sceneTriangleCounts) {
+            if (triangleCount > maximumTriangleCount) {
+                continue;
+            }
+
+            TransformEngine transformEngine;
+            benchScene scene;
+
+            if (!generateScene(sceneName, triangleCount, resultsFilePath + "." + sceneName + ".mesh", transformEngine, scene)) {
+                std::cout << "Failed to generate the " << sceneName << " scene: " << transformEngine.getLoadError() << std::endl;
+                return 1;
+            }
+
+            const size_t width = viewSizes[defaultViewSize][0];
+            const size_t height = viewSizes[defaultViewSize][1];
+            RenderEngine renderEngine;
+
+            setupView(transformEngine, renderEngine, width, height, 1);
+
+            benchResult transformResult;
+            transformResult.stage = "transform";
+            transformResult.fields.push_back({ "scene", "\"" + sceneName + "\"" });
+            transformResult.fields.push_back({ "triangles", std::to_string(triangleCount) });
+            transformResult.fields.push_back({ "instances", std::to_string(scene.instances.size()) });
+            transformResult.fields.push_back({ "width", std::to_string(width) });
+            transformResult.fields.push_back({ "height", std::to_string(height) });
+            addMeasurement(measure([&]() { transformEngine.run(); }), transformResult);
+            transformResult.fields.push_back({ "transformedTriangles", std::to_string(transformEngine.getTransformedIndexes().size() / 3) });
+            printResult(transformResult);
+            results.push_back(transformResult);
+
+            if (triangleCount <= clipMaximumTriangleCount) {
+                const std::vector<Vertex> triangles = getClipSpaceTriangles(scene, transformEngine);
+                ClipEngine clipEngine;
+                std::vector<Vertex> output;
+
+                benchResult clipResult;
+                clipResult.stage = "clip";
+                clipResult.fields.push_back({ "scene", "\"" + sceneName + "\"" });
+                clipResult.fields.push_back({ "triangles", std::to_string(triangles.size() / 3) });
+                addMeasurement(measure([&]() { output.clear(); clipEngine.clipVertexes(triangles, output); }), clipResult);
+                clipResult.fields.push_back({ "clippedTriangles", std::to_string(output.size() / 3) });
+                printResult(clipResult);
+                results.push_back(clipResult);
+            }
+
+            if (triangleCount == sweptTriangleCount && sceneName == "spheres") {
+                for (const auto &viewSize : viewSizes) {
+                    benchRender(scene, triangleCount, transformEngine, viewSize[0], viewSize[1], 1, 0, imageDirectoryPath, results);
+                }
+
+                for (size_t lightCount : lightCounts) {
+                    if (lightCount != 1) {
+                        benchRender(scene, triangleCount, transformEngine, width, height, lightCount, 0, imageDirectoryPath, results);
+                        benchRender(scene, triangleCount, transformEngine, width, height, lightCount, lightCullingThreshold,
+                            imageDirectoryPath, results);
+                    }
+                }
+            } else {
+                benchRender(scene, triangleCount, transformEngine, width, height, 1, 0, imageDirectoryPath, results);
+            }
+        }
+    }
+
+    if (!saveResults(resultsFilePath, results)) {
+        std::cout << "Failed to save results \"" << resultsFilePath << "\"" << std::endl;
+        return 1;
+    }
+
+    if (!saveGoldenFilePath.empty() && !saveGolden(saveGoldenFilePath, results)) {
+        std::cout << "Failed to save golden checksums \"" << saveGoldenFilePath << "\"" << std::endl;
+        return 1;
+    }
+
+    if (!checkGoldenFilePath.empty()) {
+        std::map<std::string, std::string> goldenChecksums;
+        size_t mismatchCount = 0;
+
+        if (!loadGolden(checkGoldenFilePath, goldenChecksums)) {
+            std::cout << "Failed to load golden checksums \"" << checkGoldenFilePath << "\"" << std::endl;
+            return 1;
+        }
+
+        // Cases missing from the golden file are new ones, they are reported but do not fail the check
+        for (const auto &result : results) {
+            if (result.checksumName.empty()) {
+                continue;
+            }
+
+            const auto golden = goldenChecksums.find(result.checksumName);
+
+            if (golden == goldenChecksums.end()) {
+                std::cout << "No golden checksum of " << result.checksumName << std::endl;
+            } else if (golden->second != result.checksum) {
+                std::cout << "Image of " << result.checksumName << " changed: " << result.checksum << " instead of " <<
+                    golden->second << std::endl;
+                ++mismatchCount;
+            }
+        }
+
+        if (mismatchCount > 0) {
+            return 2;
+        }
+
+        std::cout << "Images match the golden checksums" << std::endl;
+    }
+
+    return 0;
+}
+
+bool parseOptions(int argc, char *argv[], size_t &maximumTriangleCount, std::string &saveGoldenFilePath,
+        std::string &checkGoldenFilePath, std::string &imageDirectoryPath) {
+    // The results path comes first, so that an option like --help in its place prints the usage instead of being
+    // taken for a file name after the whole run
+    if (argv[1][0] == '-') {
+        return false;
+    }
+
+    for (int i = 2; i < argc; ++i) {
+        const std::string option = argv[i];
+
+        if (i + 1 >= argc) {
+            return false;
+        }
+
+        if (option == "--max-triangles") {
+            maximumTriangleCount = std::strtoul(argv[i+1], nullptr, 10);
+        } else if (option == "--save-golden") {
+            saveGoldenFilePath = argv[i+1];
+        } else if (option == "--check-golden") {
+            checkGoldenFilePath = argv[i+1];
+        } else if (option == "--save-images") {
+            imageDirectoryPath = argv[i+1];
+        } else {
+            return false;
+        }
+
+        i = i + 1;
+    }
+
+    return true;
+}
+
+template <typename Function>
+measurement measure(Function run) {
+    measurement time = { 0, 0, 0 };
+    double total = 0;
+
+    run();
+
+    while (time.repetitionCount < minimumRepetitionCount || total < minimumMeasurementTime) {
+        const auto start = std::chrono::steady_clock::now();
+        run();
+        const double duration = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+        time.minimum = time.repetitionCount == 0 ? duration : std::min(time.minimum, duration);
+        total = total + duration;
+        ++time.repetitionCount;
+    }
+
+    time.mean = total / time.repetitionCount;
+
+    return time;
+}
+
+// A square block of 4x4 buildings of random heights around a street, 160 triangles in a unit square
+std::vector<Vertex> generateCityBlock() {
+    const size_t lotCount = 4;
+    const Real lotSize = Real(1) / lotCount;
+    const Real buildingSize = lotSize * Real(0.7);
+    benchRandom random(7);
+    std::vector<Vertex> vertexes;
+
+    for (size_t i = 0; i < lotCount; ++i) {
+        for (size_t j = 0; j < lotCount; ++j) {
+            const Real x0 = -Real(0.5) + (i + Real(0.5)) * lotSize - buildingSize / 2;
+            const Real z0 = -Real(0.5) + (j + Real(0.5)) * lotSize - buildingSize / 2;
+            const Real x1 = x0 + buildingSize;
+            const Real z1 = z0 + buildingSize;
+            const Real height = random.getReal(Real(0.1), Real(0.6));
+            const Real shade = random.getReal(Real(0.5), Real(0.9));
+            const Vector4 color(shade, shade * random.getReal(Real(0.85), Real(1)), shade * random.getReal(Real(0.85), Real(1)), 1);
+
+            const Vector4 faces[5][4] = {
+                { Vector4(x0, height, z0, 1), Vector4(x1, height, z0, 1), Vector4(x1, height, z1, 1), Vector4(x0, height, z1, 1) },
+                { Vector4(x0, 0, z0, 1), Vector4(x1, 0, z0, 1), Vector4(x1, height, z0, 1), Vector4(x0, height, z0, 1) },
+                { Vector4(x1, 0, z1, 1), Vector4(x0, 0, z1, 1), Vector4(x0, height, z1, 1), Vector4(x1, height, z1, 1) },
+                { Vector4(x0, 0, z1, 1), Vector4(x0, 0, z0, 1), Vector4(x0, height, z0, 1), Vector4(x0, height, z1, 1) },
+                { Vector4(x1, 0, z0, 1), Vector4(x1, 0, z1, 1), Vector4(x1, height, z1, 1), Vector4(x1, height, z0, 1) }
+            };
+            const Vector4 normals[5] = { Vector4(0, 1, 0), Vector4(0, 0, -1), Vector4(0, 0, 1), Vector4(-1, 0, 0), Vector4(1, 0, 0) };
+
+            for (size_t k = 0; k < 5; ++k) {
+                addQuad(faces[k], normals[k], color, vertexes);
+            }
+        }
+    }
+
+    return vertexes;
+}
+
+// Adds two triangles ordered counter clockwise when seen from the side the normal points to
+void addQuad(const Vector4 corners[4], Vector4 normal, Vector4 color, std::vector<Vertex> &vertexes) {
+    Real edges[2][3];
+
+    for (size_t k = 0; k < 3; ++k) {
+        edges[0][k] = corners[1].c(k) - corners[0].c(k);
+        edges[1][k] = corners[2].c(k) - corners[0].c(k);
+    }
+
+    const Real orientation =
+        (edges[0][1] * edges[1][2] - edges[0][2] * edges[1][1]) * normal.cx() +
+        (edges[0][2] * edges[1][0] - edges[0][0] * edges[1][2]) * normal.cy() +
+        (edges[0][0] * edges[1][1] - edges[0][1] * edges[1][0]) * normal.cz();
+    const size_t order[2][6] = { { 0, 1, 2, 0, 2, 3 }, { 0, 2, 1, 0, 3, 2 } };
+
+    for (size_t k : order[orientation > 0 ? 0 : 1]) {
+        Vertex vertex;
+        vertex.origin = vertex.position = corners[k];
+        vertex.color = color;
+        vertex.normal = normal;
+        vertexes.push_back(vertex);
+    }
+}
+
+// Places copies of one mesh on a square grid of cells covering the scene, as many as it takes to reach the triangle
+// count. The mesh is saved to a file for the scene to refer to, which is removed once the scene is loaded.
+bool generateScene(const std::string &name, size_t triangleCount, const std::string &meshFilePath, TransformEngine &transformEngine, benchScene &scene) {
+    std::vector<Vertex> vertexes = name == "spheres" ? Shapes::generateSphere(1, 24, 22) : generateCityBlock();
+
+    transformEngine.loadModelFromVertexArray(vertexes);
+
+    if (!transformEngine.getMesh(0).saveToBinaryFile(meshFilePath)) {
+        return false;
+    }
+
+    const size_t meshTriangleCount = transformEngine.getMesh(0).getTriangleCount();
+    const size_t instanceCount = std::max<size_t>(1, (triangleCount + meshTriangleCount / 2) / meshTriangleCount);
+    const size_t gridSize = static_cast<size_t>(std::ceil(std::sqrt(static_cast<double>(instanceCount))));
+    const Real cellSize = sceneSize / gridSize;
+    benchRandom random(11);
+    std::ostringstream buffer;
+
+    scene.name = name;
+    scene.instances.clear();
+    buffer << std::setprecision(17) << "mesh " << meshFilePath << "\n";
+
+    for (size_t i = 0; i < instanceCount; ++i) {
+        benchInstance instance;
+
+        instance.x = -sceneSize / 2 + (i % gridSize + Real(0.5)) * cellSize;
+        instance.z = -sceneSize / 2 + (i / gridSize + Real(0.5)) * cellSize;
+
+        if (name == "spheres") {
+            instance.scale = cellSize * Real(0.4);
+            instance.y = instance.scale;
+            instance.angle = 0;
+        } else {
+            instance.scale = cellSize;
+            instance.y = 0;
+            instance.angle = 90 * std::floor(random.getReal(0, 4));
+        }
+
+        scene.instances.push_back(instance);
+        buffer << "instance 0 " << instance.x << " " << instance.y << " " << instance.z << " 0 " << instance.angle << " 0 " <<
+            instance.scale << "\n";
+    }
+
+    const bool isLoaded = transformEngine.loadSceneFromBuffer(buffer.str());
+    std::remove(meshFilePath.c_str());
+
+    return isLoaded;
+}
+
+// Every triangle of every instance in clip space of the current view, including the ones outside of the view
+std::vector<Vertex> getClipSpaceTriangles(const benchScene &scene, const TransformEngine &transformEngine) {
+    const Mesh &mesh = transformEngine.getMesh(0);
+    const Vector4 viewTranslation = transformEngine.getViewTranslation();
+    const Vector4 viewRotation = transformEngine.getViewRotation();
+    const Matrix4x4 viewMatrix = getPerspectiveMatrix(transformEngine.getFovy(), transformEngine.getZNear(), transformEngine.getZFar(),
+        transformEngine.getViewWidth() / transformEngine.getViewHeight()) *
+        getRotationMatrix(viewRotation.cx(), viewRotation.cy(), viewRotation.cz()) *
+        getTranslationMatrix(viewTranslation.cx(), viewTranslation.cy(), viewTranslation.cz());
+    std::vector<Vector4> clipPositions(mesh.getVertexCount());
+    std::vector<Vertex> triangles;
+
+    triangles.reserve(scene.instances.size() * mesh.getIndexCount());
+
+    for (const auto &instance : scene.instances) {
+        const Matrix4x4 transformMatrix = viewMatrix * getTranslationMatrix(instance.x, instance.y, instance.z) *
+            getRotationMatrix(0, instance.angle * PI / 180, 0) * getScaleMatrix(instance.scale, instance.scale, instance.scale);
+
+        transformMatrix.transformBatch(mesh.getPositions(), clipPositions.data(), clipPositions.size());
+
+        for (size_t i = 0; i < mesh.getIndexCount(); ++i) {
+            triangles.push_back(mesh.getVertexes()[mesh.getIndexes()[i]]);
+            triangles.back().position = clipPositions[mesh.getIndexes()[i]];
+        }
+    }
+
+    return triangles;
+}
+
+// Point lights hanging above the scene, the first one is white and the others have random colors. They share one
+// intensity, so that the scene is about as bright whatever the light count.
+std::vector<LightSource> generateLightSources(size_t lightCount) {
+    benchRandom random(13);
+    std::vector<LightSource> lightSources;
+
+    for (size_t i = 0; i < lightCount; ++i) {
+        const Vector4 position(random.getReal(-sceneSize / 2, sceneSize / 2), random.getReal(2, 6), random.getReal(-sceneSize / 2, sceneSize / 2), 1);
+        const Vector4 color = i == 0 ? Vector4(1, 1, 1, 1) :
+            Vector4(random.getReal(Real(0.2), 1), random.getReal(Real(0.2), 1), random.getReal(Real(0.2), 1), 1);
+
+        lightSources.push_back(LightSource(position, Real(8) / lightCount, color));
+    }
+
+    return lightSources;
+}
+
+void setupView(TransformEngine &transformEngine, RenderEngine &renderEngine, size_t width, size_t height, size_t lightCount) {
+    transformEngine.setViewSize(width, height);
+    transformEngine.setViewTranslation(sceneViewTranslation[0], sceneViewTranslation[1], sceneViewTranslation[2]);
+    transformEngine.setViewRotation(sceneViewAngle, 0, 0);
+
+    renderEngine.setViewSize(width, height);
+    renderEngine.getLightEngine().loadLightSourcesFromArray(generateLightSources(lightCount), LightSource(Vector4(), Real(0.3), Vector4(1, 1, 1, 1)));
+    renderEngine.getLightEngine().loadMaterialFromValues(Vector4(1, 1, 1, 1), Vector4(Real(0.7), Real(0.7), Real(0.7), 1),
+        Vector4(Real(0.3), Real(0.3), Real(0.3), 1), 16);
+    renderEngine.getLightEngine().setViewTranslation(transformEngine.getViewTranslation());
+}
+
+void benchMatrixProducts(std::vector<benchResult> &results) {
+    const Matrix4x4 rotationMatrix = getRotationMatrix(Real(0.001), Real(0.002), Real(0.003));
+    std::vector<Vector4> vectors(matrixVectorCount), transformedVectors(matrixVectorCount);
+    benchRandom random(17);
+    Matrix4x4 product = getIdentityMatrix();
+
+    for (auto &vector : vectors) {
+        vector = Vector4(random.getReal(-1, 1), random.getReal(-1, 1), random.getReal(-1, 1), 1);
+    }
+
+    // Each product depends on the previous one, so that none of them can be skipped
+    benchResult productResult;
+    productResult.stage = "matrixProduct";
+    productResult.fields.push_back({ "products", std::to_string(matrixProductCount) });
+    addMeasurement(measure([&]() {
+        for (size_t i = 0; i < matrixProductCount; ++i) {
+            product = rotationMatrix * product;
+        }
+    }), productResult);
+    productResult.fields.push_back({ "resultLength", toString((product * Vector4(1, 1, 1, 1)).getLength()) });
+    printResult(productResult);
+    results.push_back(productResult);
+
+    benchResult batchResult;
+    batchResult.stage = "matrixTransformBatch";
+    batchResult.fields.push_back({ "vectors", std::to_string(matrixVectorCount) });
+    addMeasurement(measure([&]() { rotationMatrix.transformBatch(vectors.data(), transformedVectors.data(), matrixVectorCount); }), batchResult);
+    printResult(batchResult);
+    results.push_back(batchResult);
+}
+
+// Lights random points with the scalar and the batch functions and reports how far the batch results are off
+void benchLighting(std::vector<benchResult> &results) {
+    std::vector<Vector4> positions(lightPointCount), normals(lightPointCount), lights(lightPointCount), culledLights(lightPointCount);
+    std::vector<float> batchInput[6], batchLights[4];
+    benchRandom random(19);
+
+    for (size_t i = 0; i < lightPointCount; ++i) {
+        positions[i] = Vector4(random.getReal(-sceneSize / 2, sceneSize / 2), random.getReal(0, 2), random.getReal(-sceneSize / 2, sceneSize / 2), 1);
+        normals[i] = Vector4(random.getReal(-1, 1), random.getReal(0, 1), random.getReal(-1, 1));
+        normals[i].normalize();
+    }
+
+    for (size_t k = 0; k < 3; ++k) {
+        for (size_t i = 0; i < lightPointCount; ++i) {
+            batchInput[k].push_back(static_cast<float>(positions[i].c(k)));
+            batchInput[k+3].push_back(static_cast<float>(normals[i].c(k)));
+        }
+    }
+
+    for (auto &channel : batchLights) {
+        channel.resize(lightPointCount);
+    }
+
+    const float *const batchPositions[3] = { batchInput[0].data(), batchInput[1].data(), batchInput[2].data() };
+    const float *const batchNormals[3] = { batchInput[3].data(), batchInput[4].data(), batchInput[5].data() };
+    float *const batchOutput[4] = { batchLights[0].data(), batchLights[1].data(), batchLights[2].data(), batchLights[3].data() };
+
+    for (size_t lightCount : lightCounts) {
+        TransformEngine transformEngine;
+        RenderEngine renderEngine;
+        const LightEngine &lightEngine = renderEngine.getLightEngine();
+
+        setupView(transformEngine, renderEngine, viewSizes[defaultViewSize][0], viewSizes[defaultViewSize][1], lightCount);
+
+        benchResult lightResult;
+        lightResult.stage = "light";
+        lightResult.fields.push_back({ "points", std::to_string(lightPointCount) });
+        lightResult.fields.push_back({ "lights", std::to_string(lightCount) });
+        addMeasurement(measure([&]() {
+            for (size_t i = 0; i < lightPointCount; ++i) {
+                lights[i] = lightEngine.getLight(positions[i], normals[i]);
+            }
+        }), lightResult);
+
+        const measurement batchTime = measure([&]() { lightEngine.getLights(lightPointCount, batchPositions, batchNormals, batchOutput); });
+        Real maximumDifference = 0;
+
+        for (size_t i = 0; i < lightPointCount; ++i) {
+            for (size_t k = 0; k < 4; ++k) {
+                maximumDifference = std::max(maximumDifference, std::abs(lights[i].c(k) - static_cast<Real>(batchLights[k][i])));
+            }
+        }
+
+        lightResult.fields.push_back({ "batchMeanMs", toString(batchTime.mean) });
+        lightResult.fields.push_back({ "batchMinimumMs", toString(batchTime.minimum) });
+        lightResult.fields.push_back({ "batchMaximumDifference", toString(maximumDifference) });
+
+        // The same points with lights culled, and how far culling moves their light from the exact one
+        renderEngine.getLightEngine().setLightCullingThreshold(lightCullingThreshold);
+
+        const measurement culledTime = measure([&]() {
+            for (size_t i = 0; i < lightPointCount; ++i) {
+                culledLights[i] = lightEngine.getLight(positions[i], normals[i]);
+            }
+        });
+        const measurement culledBatchTime = measure([&]() { lightEngine.getLights(lightPointCount, batchPositions, batchNormals, batchOutput); });
+        Real culledMaximumDifference = 0;
+
+        for (size_t i = 0; i < lightPointCount; ++i) {
+            for (size_t k = 0; k < 4; ++k) {
+                culledMaximumDifference = std::max(culledMaximumDifference, std::abs(lights[i].c(k) - culledLights[i].c(k)));
+            }
+        }
+
+        lightResult.fields.push_back({ "lightCullingThreshold", toString(lightCullingThreshold) });
+        lightResult.fields.push_back({ "culledMeanMs", toString(culledTime.mean) });
+        lightResult.fields.push_back({ "culledMinimumMs", toString(culledTime.minimum) });
+        lightResult.fields.push_back({ "culledBatchMeanMs", toString(culledBatchTime.mean) });
+        lightResult.fields.push_back({ "culledBatchMinimumMs", toString(culledBatchTime.minimum) });
+        lightResult.fields.push_back({ "culledMaximumDifference", toString(culledMaximumDifference) });
+        printResult(lightResult);
+        results.push_back(lightResult);
+    }
+}
+
+// Every case is rendered by both rasterizers. Every repetition reloads the material, so that no vertex is served from
+// the light cache of the previous frame.
+void benchRender(const benchScene &scene, size_t triangleCount, TransformEngine &transformEngine, size_t width, size_t height,
+        size_t lightCount, Real lightCullingThreshold, const std::string &imageDirectoryPath, std::vector<benchResult> &results) {
+    RenderEngine renderEngine;
+    LightEngine &lightEngine = renderEngine.getLightEngine();
+
+    setupView(transformEngine, renderEngine, width, height, lightCount);
+    lightEngine.setLightCullingThreshold(lightCullingThreshold);
+    transformEngine.run();
+
+    for (const benchRasterizer &rasterizer : rasterizers) {
+        renderEngine.setRasterizationMode(rasterizer.mode);
+
+        benchResult renderResult;
+        renderResult.stage = "render";
+        renderResult.fields.push_back({ "scene", "\"" + scene.name + "\"" });
+        renderResult.fields.push_back({ "triangles", std::to_string(triangleCount) });
+        renderResult.fields.push_back({ "transformedTriangles", std::to_string(transformEngine.getTransformedIndexes().size() / 3) });
+        renderResult.fields.push_back({ "width", std::to_string(width) });
+        renderResult.fields.push_back({ "height", std::to_string(height) });
+        renderResult.fields.push_back({ "lights", std::to_string(lightCount) });
+        renderResult.fields.push_back({ "lightCullingThreshold", toString(lightCullingThreshold) });
+        renderResult.fields.push_back({ "rasterizer", "\"" + std::string(rasterizer.name) + "\"" });
+        addMeasurement(measure([&]() {
+            lightEngine.loadMaterialFromValues(Vector4(1, 1, 1, 1), Vector4(Real(0.7), Real(0.7), Real(0.7), 1),
+                Vector4(Real(0.3), Real(0.3), Real(0.3), 1), 16);
+            renderEngine.setVertexArray(transformEngine.getTransformedVertexes(), transformEngine.getTransformedIndexes());
+            renderEngine.run();
+        }), renderResult);
+
+        renderResult.checksumName = scene.name + "-" + std::to_string(triangleCount) + "-" + std::to_string(width) + "x" +
+            std::to_string(height) + "-" + std::to_string(lightCount) + (lightCullingThreshold > 0 ? "-culled" : "") + "-" +
+            rasterizer.name;
+        renderResult.checksum = getChecksum(renderEngine.getImage());
+        renderResult.fields.push_back({ "checksum", "\"" + renderResult.checksum + "\"" });
+        printResult(renderResult);
+        results.push_back(renderResult);
+
+        if (!imageDirectoryPath.empty()) {
+            ImageWriter imageWriter;
+            const std::string imageFilePath = imageDirectoryPath + "/" + renderResult.checksumName + ".png";
+
+            if (!imageWriter.saveToFile(imageFilePath, renderEngine.getImage(), width, height)) {
+                std::cout << "Failed to save image \"" << imageFilePath << "\": " << imageWriter.getSaveError() << std::endl;
+            }
+        }
+    }
+}
+
+void addMeasurement(const measurement &time, benchResult &result) {
+    result.fields.push_back({ "repetitions", std::to_string(time.repetitionCount) });
+    result.fields.push_back({ "meanMs", toString(time.mean) });
+    result.fields.push_back({ "minimumMs", toString(time.minimum) });
+}
+
+// 64-bit FNV-1a of the packed image
+std::string getChecksum(const std::vector<uint8_t> &image) {
+    uint64_t hash = 14695981039346656037ull;
+    std::ostringstream stream;
+
+    for (uint8_t value : image) {
+        hash = (hash ^ value) * 1099511628211ull;
+    }
+
+    stream << std::hex << std::setw(16) << std::setfill('0') << hash;
+
+    return stream.str();
+}
+
+// Six significant digits, which keeps small values like differences readable
+std::string toString(double value) {
+    std::ostringstream stream;
+
+    stream << value;
+
+    return stream.str();
+}
+
+void printResult(const benchResult &result) {
+    std::cout << result.stage;
+
+    for (const auto &field : result.fields) {
+        std::cout << " " << field.first << "=" << field.second;
+    }
+
+    std::cout << std::endl;
+}
+
+bool saveResults(const std::string &filePath, const std::vector<benchResult> &results) {
+    std::ofstream file(filePath);
+
+    if (!file.is_open()) {
+        return false;
+    }
+
+    file << "{\n    \"precision\": \"" << (sizeof(Real) == sizeof(float) ? "single" : "double") << "\",\n    \"results\": [";
+
+    for (size_t i = 0; i < results.size(); ++i) {
+        file << (i == 0 ? "\n" : ",\n") << "        { \"stage\": \"" << results[i].stage << "\"";
+
+        for (const auto &field : results[i].fields) {
+            file << ", \"" << field.first << "\": " << field.second;
+        }
+
+        file << " }";
+    }
+
+    file << "\n    ]\n}\n";
+
+    return !file.fail();
+}
+
+// Golden files hold one case name and image checksum per line
+bool loadGolden(const std::string &filePath, std::map<std::string, std::string> &checksums) {
+    std::ifstream file(filePath);
+    std::string name, checksum;
+
+    if (!file.is_open()) {
+        return false;
+    }
+
+    while (file >> name >> checksum) {
+        checksums[name] = checksum;
+    }
+
+    return file.eof();
+}
+
+bool saveGolden(const std::string &filePath, const std::vector<benchResult> &results) {
+    std::ofstream file(filePath);
+
+    if (!file.is_open()) {
+        return false;
+    }
+
+    for (const auto &result : results) {
+        if (!result.checksumName.empty()) {
+            file << result.checksumName << " " << result.checksum << "\n";
+        }
+    }
+
+    return !file.fail();
+}
+
+void printUsage() {
+    std::cout << "Usage: bench results-file-path [--max-triangles count] [--save-golden golden-file-path]" << std::endl;
+    std::cout << "    [--check-golden golden-file-path] [--save-images directory-path]" << std::endl;
+}
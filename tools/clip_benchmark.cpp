@@ -0,0 +1,85 @@
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include "../clip_engine.h"
+#include "../transform.h"
+#include "../transform_engine.h"
+
+// Every allocation of the process is counted, so that the clipping loop can be shown not to allocate
+std::atomic<size_t> allocationCount(0);
+
+void* operator new(size_t size) {
+    ++allocationCount;
+
+    if (void *memory = std::malloc(size == 0 ? 1 : size)) {
+        return memory;
+    }
+
+    throw std::bad_alloc();
+}
+
+void operator delete(void *memory) noexcept {
+    std::free(memory);
+}
+
+void printUsage();
+
+// Clips the triangles of a model seen from inside of it again and again, like a frame would, and reports the time
+// and the heap allocations per frame once the output buffer stopped growing
+int main(int argc, char *argv[]) {
+    const size_t warmUpFrameCount = 3;
+    const size_t frameCount = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 100;
+    TransformEngine transformEngine;
+    ClipEngine clipEngine;
+    std::vector<Vertex> triangles, output;
+
+    if (argc < 2 || frameCount == 0) {
+        printUsage();
+        return 1;
+    }
+
+    if (!transformEngine.loadModelFromFile(argv[1]) || transformEngine.getMeshCount() == 0) {
+        std::cout << "Failed to load model \"" << argv[1] << "\": " << transformEngine.getLoadError() << std::endl;
+        return 1;
+    }
+
+    // The view is at the center of the model, so that most triangles cross the near plane or the guard band
+    const Mesh &mesh = transformEngine.getMesh(0);
+    const Matrix4x4 transformMatrix = getPerspectiveMatrix(PI / 3, 0.1, 100, 1) * getRotationMatrix(0, PI / 6, 0);
+    std::vector<Vector4> clipPositions(mesh.getVertexCount());
+
+    transformMatrix.transformBatch(mesh.getPositions(), clipPositions.data(), clipPositions.size());
+
+    for (size_t i = 0; i < mesh.getIndexCount(); ++i) {
+        triangles.push_back(mesh.getVertexes()[mesh.getIndexes()[i]]);
+        triangles.back().position = clipPositions[mesh.getIndexes()[i]];
+    }
+
+    size_t allocationsBefore = 0;
+    auto start = std::chrono::steady_clock::now();
+
+    for (size_t frame = 0; frame < warmUpFrameCount + frameCount; ++frame) {
+        if (frame == warmUpFrameCount) {
+            allocationsBefore = allocationCount;
+            start = std::chrono::steady_clock::now();
+        }
+
+        output.clear();
+        clipEngine.clipVertexes(triangles, output);
+    }
+
+    const auto end = std::chrono::steady_clock::now();
+    const size_t allocations = allocationCount - allocationsBefore;
+
+    std::cout << "Clipped " << triangles.size() / 3 << " triangles into " << output.size() / 3 << " triangles in " <<
+        std::chrono::duration<double, std::milli>(end - start).count() / frameCount << " ms per frame, " <<
+        static_cast<double>(allocations) / frameCount << " heap allocations per frame" << std::endl;
+
+    return allocations == 0 ? 0 : 2;
+}
+
+void printUsage() {
+    std::cout << "Usage: clip-benchmark model-file-path [frame-count]" << std::endl;
+}
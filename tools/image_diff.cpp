@@ -0,0 +1,90 @@
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <SFML/Graphics.hpp>
+
+// Differences are scaled up in the difference image, so that single rounding steps are still visible
+const unsigned differenceScale = 16;
+
+void printUsage();
+
+// Compares two images of the same size channel by channel, optionally writes an image which is black where
+// they match and brighter the more they differ, and fails when the largest difference exceeds the tolerance
+int main(int argc, char *argv[]) {
+    sf::Image firstImage, secondImage, differenceImage;
+
+    if (argc < 3) {
+        printUsage();
+        return 1;
+    }
+
+    std::string differenceFilePath = argc > 3 ? argv[3] : "";
+    unsigned tolerance = argc > 4 ? static_cast<unsigned>(std::atoi(argv[4])) : 255;
+
+    if (!firstImage.loadFromFile(argv[1])) {
+        std::cout << "Failed to load image \"" << argv[1] << "\"" << std::endl;
+        return 1;
+    }
+
+    if (!secondImage.loadFromFile(argv[2])) {
+        std::cout << "Failed to load image \"" << argv[2] << "\"" << std::endl;
+        return 1;
+    }
+
+    const unsigned width = firstImage.getSize().x;
+    const unsigned height = firstImage.getSize().y;
+
+    if (secondImage.getSize().x != width || secondImage.getSize().y != height) {
+        std::cout << "Images have different sizes" << std::endl;
+        return 1;
+    }
+
+    unsigned maxDifference = 0;
+    unsigned long long differenceSum = 0;
+    size_t differentPixelCount = 0;
+
+    differenceImage.create(width, height);
+
+    for (unsigned y = 0; y < height; ++y) {
+        for (unsigned x = 0; x < width; ++x) {
+            const sf::Color a = firstImage.getPixel(x, y);
+            const sf::Color b = secondImage.getPixel(x, y);
+            const unsigned differences[] = {
+                static_cast<unsigned>(std::abs(a.r - b.r)),
+                static_cast<unsigned>(std::abs(a.g - b.g)),
+                static_cast<unsigned>(std::abs(a.b - b.b)),
+                static_cast<unsigned>(std::abs(a.a - b.a)) };
+            const unsigned pixelDifference = *std::max_element(differences, differences + 4);
+
+            for (unsigned difference : differences) {
+                differenceSum += difference;
+            }
+
+            if (pixelDifference > 0) {
+                ++differentPixelCount;
+            }
+
+            maxDifference = std::max(maxDifference, pixelDifference);
+
+            const sf::Uint8 brightness = static_cast<sf::Uint8>(std::min(pixelDifference * differenceScale, 255u));
+            differenceImage.setPixel(x, y, sf::Color(brightness, brightness, brightness));
+        }
+    }
+
+    const size_t pixelCount = static_cast<size_t>(width) * height;
+
+    std::cout << "Different pixels: " << differentPixelCount << " of " << pixelCount << std::endl;
+    std::cout << "Max channel difference: " << maxDifference << std::endl;
+    std::cout << "Mean channel difference: " << (pixelCount > 0 ? differenceSum / (4.0 * pixelCount) : 0.0) << std::endl;
+
+    if (!differenceFilePath.empty() && !differenceImage.saveToFile(differenceFilePath)) {
+        std::cout << "Failed to save image \"" << differenceFilePath << "\"" << std::endl;
+        return 1;
+    }
+
+    return maxDifference > tolerance ? 2 : 0;
+}
+
+void printUsage() {
+    std::cout << "Usage: image-diff first-image-path second-image-path [difference-image-path] [tolerance]" << std::endl;
+}
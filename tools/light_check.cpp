@@ -0,0 +1,167 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <limits>
+#include <string>
+#include <vector>
+#include "../light_engine.h"
+
+// Batch lighting runs in single precision with a polynomial specular power, so it may differ from the scalar functions
+// by the rounding tolerance plus the specular tolerance times the shininess. Differences are relative to the scalar
+// light, or absolute where the light is darker than one.
+const Real roundingTolerance = 2e-5;
+const Real specularTolerance = 1e-6;
+
+const size_t lightCounts[] = { 1, 8, 64 };
+const Real shininesses[] = { 1, 16, 128 };
+const Real lightCullingThresholds[] = { 0, Real(1) / 512 };
+
+// Deterministic pseudo random numbers, so that every run checks the same points
+class checkRandom {
+
+public:
+
+    checkRandom(uint32_t seed) : state(seed) {}
+
+    Real getReal(Real minimum, Real maximum) {
+        state = state * 1664525 + 1013904223;
+        return minimum + (maximum - minimum) * static_cast<Real>(state >> 8) / static_cast<Real>(1 << 24);
+    }
+
+private:
+
+    uint32_t state;
+
+};
+
+std::vector<LightSource> generateLightSources(size_t lightCount, checkRandom &random);
+Real getMaximumDifference(const std::vector<Vector4> &lights, const std::vector<float> batchLights[4]);
+void printUsage();
+
+// Lights random points with the batch functions and with the scalar functions they stand in for, for several light
+// counts, materials and culling thresholds, and exits with code 2 if any channel differs by more than the tolerance
+int main(int argc, char *argv[]) {
+    const size_t pointCount = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 10000;
+    std::vector<Vector4> positions(pointCount), normals(pointCount), lights(pointCount);
+    std::vector<float> batchInput[6], batchLights[4];
+    checkRandom random(23);
+    size_t failedCaseCount = 0;
+    size_t caseCount = 0;
+
+    if (argc > 2 || pointCount == 0) {
+        printUsage();
+        return 1;
+    }
+
+    // Every hundredth normal is zero, which both paths leave without diffuse and specular light
+    for (size_t i = 0; i < pointCount; ++i) {
+        positions[i] = Vector4(random.getReal(-10, 10), random.getReal(-10, 10), random.getReal(-10, 10), 1);
+
+        if (i % 100 != 0) {
+            normals[i] = Vector4(random.getReal(-1, 1), random.getReal(-1, 1), random.getReal(-1, 1));
+        }
+
+        for (size_t k = 0; k < 3; ++k) {
+            batchInput[k].push_back(static_cast<float>(positions[i].c(k)));
+            batchInput[k+3].push_back(static_cast<float>(normals[i].c(k)));
+        }
+    }
+
+    for (auto &channel : batchLights) {
+        channel.resize(pointCount);
+    }
+
+    const float *const batchPositions[3] = { batchInput[0].data(), batchInput[1].data(), batchInput[2].data() };
+    const float *const batchNormals[3] = { batchInput[3].data(), batchInput[4].data(), batchInput[5].data() };
+    float *const batchOutput[4] = { batchLights[0].data(), batchLights[1].data(), batchLights[2].data(), batchLights[3].data() };
+
+    for (size_t lightCount : lightCounts) {
+        for (Real shininess : shininesses) {
+            for (Real lightCullingThreshold : lightCullingThresholds) {
+                LightEngine lightEngine;
+                const Real tolerance = roundingTolerance + specularTolerance * shininess;
+                Real differences[3];
+
+                lightEngine.loadLightSourcesFromArray(generateLightSources(lightCount, random),
+                    LightSource(Vector4(), Real(0.3), Vector4(1, 1, 1, 1)));
+                lightEngine.loadMaterialFromValues(Vector4(Real(0.2), Real(0.2), Real(0.2), 1),
+                    Vector4(Real(0.7), Real(0.6), Real(0.5), 1), Vector4(Real(0.3), Real(0.4), Real(0.5), 1), shininess, 1);
+                lightEngine.setViewTranslation(random.getReal(-5, 5), random.getReal(-5, 5), random.getReal(10, 20));
+                lightEngine.setLightCullingThreshold(lightCullingThreshold);
+
+                for (size_t i = 0; i < pointCount; ++i) {
+                    lights[i] = lightEngine.getLight(positions[i], normals[i]);
+                }
+
+                lightEngine.getLights(pointCount, batchPositions, batchNormals, batchOutput);
+                differences[0] = getMaximumDifference(lights, batchLights);
+
+                for (size_t i = 0; i < pointCount; ++i) {
+                    lights[i] = lightEngine.getViewIndependentLight(positions[i], normals[i]);
+                }
+
+                lightEngine.getViewIndependentLights(pointCount, batchPositions, batchNormals, batchOutput);
+                differences[1] = getMaximumDifference(lights, batchLights);
+
+                for (size_t i = 0; i < pointCount; ++i) {
+                    lights[i] = lightEngine.getSpecularLight(positions[i], normals[i]);
+                }
+
+                lightEngine.getSpecularLights(pointCount, batchPositions, batchNormals, batchOutput);
+                differences[2] = getMaximumDifference(lights, batchLights);
+
+                const bool isWithinTolerance = *std::max_element(differences, differences + 3) <= tolerance;
+
+                std::cout << lightCount << (lightCount == 1 ? " light" : " lights") << ", shininess " << shininess <<
+                    ", culling threshold " << lightCullingThreshold << ": light " << differences[0] << ", view independent " <<
+                    differences[1] << ", specular " << differences[2] << (isWithinTolerance ? ", within" : ", above") <<
+                    " the tolerance of " << tolerance << std::endl;
+
+                failedCaseCount = failedCaseCount + (isWithinTolerance ? 0 : 1);
+                ++caseCount;
+            }
+        }
+    }
+
+    std::cout << LightEngine::getBatchInstructionSet() << " batch lighting of " << pointCount << " points is above the tolerance in " <<
+        failedCaseCount << " of " << caseCount << " cases" << std::endl;
+
+    return failedCaseCount == 0 ? 0 : 2;
+}
+
+// Point lights around the points with random colors and intensities
+std::vector<LightSource> generateLightSources(size_t lightCount, checkRandom &random) {
+    std::vector<LightSource> lightSources;
+
+    for (size_t i = 0; i < lightCount; ++i) {
+        const Vector4 position(random.getReal(-12, 12), random.getReal(-12, 12), random.getReal(-12, 12), 1);
+        const Vector4 color(random.getReal(Real(0.2), 1), random.getReal(Real(0.2), 1), random.getReal(Real(0.2), 1), 1);
+
+        lightSources.push_back(LightSource(position, random.getReal(1, 8), color));
+    }
+
+    return lightSources;
+}
+
+// Largest difference of any channel, relative to the scalar light where it is brighter than one
+Real getMaximumDifference(const std::vector<Vector4> &lights, const std::vector<float> batchLights[4]) {
+    Real maximumDifference = 0;
+
+    for (size_t i = 0; i < lights.size(); ++i) {
+        for (size_t k = 0; k < 4; ++k) {
+            const Real difference = std::abs(lights[i].c(k) - static_cast<Real>(batchLights[k][i])) /
+                std::max(std::abs(lights[i].c(k)), Real(1));
+
+            // NaN counts as the largest difference
+            maximumDifference = std::isnan(difference) ? std::numeric_limits<Real>::infinity() : std::max(maximumDifference, difference);
+        }
+    }
+
+    return maximumDifference;
+}
+
+void printUsage() {
+    std::cout << "Usage: light-check [point-count]" << std::endl;
+}
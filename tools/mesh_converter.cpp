@@ -0,0 +1,35 @@
+#include <iostream>
+#include "../transform_engine.h"
+
+void printUsage();
+
+// Converts a model file into a binary mesh, which the engine of the same precision maps without parsing
+int main(int argc, char *argv[]) {
+    TransformEngine transformEngine;
+
+    if (argc < 3) {
+        printUsage();
+        return 1;
+    }
+
+    if (!transformEngine.loadModelFromFile(argv[1])) {
+        std::cout << "Failed to load model \"" << argv[1] << "\": " << transformEngine.getLoadError() << std::endl;
+        return 1;
+    }
+
+    const Mesh &model = transformEngine.getMesh(0);
+
+    if (!model.saveToBinaryFile(argv[2])) {
+        std::cout << "Failed to save mesh \"" << argv[2] << "\"" << std::endl;
+        return 1;
+    }
+
+    std::cout << "Converted " << model.getSourceVertexCount() << " vertexes, " << model.getVertexCount() << " unique (" <<
+        model.getWeldRatio() << "x), " << model.getTriangleCount() << " triangles" << std::endl;
+
+    return 0;
+}
+
+void printUsage() {
+    std::cout << "Usage: mesh-converter model-file-path mesh-file-path" << std::endl;
+}
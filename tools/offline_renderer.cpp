@@ -0,0 +1,236 @@
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include "../frame_statistics.h"
+#include "../image_writer.h"
+#include "../model_streamer.h"
+#include "../render_engine.h"
+#include "../transform_engine.h"
+
+// Time spent outside of the frames
+struct stageTimes {
+    double load = 0;
+    double save = 0;
+};
+
+bool parseOptions(int argc, char *argv[], TransformEngine &transformEngine, RenderEngine &renderEngine, size_t &frameCount);
+double getMilliseconds(std::chrono::steady_clock::time_point start);
+void printUsage();
+
+// Renders one view of a model into an image file without opening a window and prints the time of every stage,
+// so that frames can be rendered on machines without a display and their performance compared between builds
+int main(int argc, char *argv[]) {
+    TransformEngine transformEngine;
+    RenderEngine renderEngine;
+    ModelStreamer modelStreamer;
+    ImageWriter imageWriter;
+    stageTimes times;
+    FrameStatistics frameStatistics, stageTotals;
+    size_t frameCount = 1;
+
+    if (argc < 5) {
+        printUsage();
+        return 1;
+    }
+
+    const std::string modelFilePath = argv[1];
+    const std::string materialFilePath = argv[2];
+    const std::string lightSourcesFilePath = argv[3];
+    const std::string imageFilePath = argv[4];
+
+    // Moves camera to (0,0,-5) unless told otherwise, like the application does
+    transformEngine.setViewTranslation(0, 0, 5);
+
+    if (!parseOptions(argc, argv, transformEngine, renderEngine, frameCount)) {
+        printUsage();
+        return 1;
+    }
+
+    const bool isModelStreamed = ModelStreamer::isStreamedFile(modelFilePath);
+    auto start = std::chrono::steady_clock::now();
+
+    if (isModelStreamed) {
+        if (!modelStreamer.open(modelFilePath)) {
+            std::cout << "Failed to load model \"" << modelFilePath << "\": " << modelStreamer.getLoadError() << std::endl;
+            return 1;
+        }
+    } else if (TransformEngine::isSceneFile(modelFilePath)) {
+        if (!transformEngine.loadSceneFromFile(modelFilePath)) {
+            std::cout << "Failed to load scene \"" << modelFilePath << "\": " << transformEngine.getLoadError() << std::endl;
+            return 1;
+        }
+    } else if (!transformEngine.loadModelFromFile(modelFilePath)) {
+        std::cout << "Failed to load model \"" << modelFilePath << "\": " << transformEngine.getLoadError() << std::endl;
+        return 1;
+    }
+
+    if (!renderEngine.getLightEngine().loadMaterialFromFile(materialFilePath)) {
+        std::cout << "Failed to load material \"" << materialFilePath << "\": " <<
+            renderEngine.getLightEngine().getLoadError() << std::endl;
+        return 2;
+    }
+
+    if (!renderEngine.getLightEngine().loadLightSourcesFromFile(lightSourcesFilePath)) {
+        std::cout << "Failed to load light sources \"" << lightSourcesFilePath << "\": " <<
+            renderEngine.getLightEngine().getLoadError() << std::endl;
+        return 3;
+    }
+
+    times.load = getMilliseconds(start);
+
+    renderEngine.setViewSize(transformEngine.getViewWidth(), transformEngine.getViewHeight());
+    renderEngine.getLightEngine().setViewTranslation(transformEngine.getViewTranslation());
+
+    FrameTimeHistory frameTimeHistory(frameCount);
+
+    // Frames are timed as a whole, the stages are a breakdown of them
+    for (size_t frame = 0; frame < frameCount; ++frame) {
+        const auto frameStart = std::chrono::steady_clock::now();
+
+        if (isModelStreamed) {
+            if (!modelStreamer.drawFrame(transformEngine, renderEngine, frameStatistics)) {
+                std::cout << "Failed to load model \"" << modelFilePath << "\": " << modelStreamer.getLoadError() << std::endl;
+                return 1;
+            }
+        } else {
+            transformEngine.run();
+            renderEngine.setVertexArray(transformEngine.getTransformedVertexes(), transformEngine.getTransformedIndexes());
+            renderEngine.run();
+
+            frameStatistics = FrameStatistics();
+            frameStatistics.addTransformStatistics(transformEngine);
+            frameStatistics.setRenderStatistics(renderEngine);
+        }
+
+        frameStatistics.frameTime = getMilliseconds(frameStart);
+        stageTotals.readTime = stageTotals.readTime + frameStatistics.readTime;
+        stageTotals.transformTime = stageTotals.transformTime + frameStatistics.transformTime;
+        stageTotals.clipTime = stageTotals.clipTime + frameStatistics.clipTime;
+        stageTotals.lightTime = stageTotals.lightTime + frameStatistics.lightTime;
+        stageTotals.rasterTime = stageTotals.rasterTime + frameStatistics.rasterTime;
+        stageTotals.shadeTime = stageTotals.shadeTime + frameStatistics.shadeTime;
+        frameTimeHistory.addFrameTime(frameStatistics.frameTime);
+    }
+
+    start = std::chrono::steady_clock::now();
+
+    if (!imageWriter.saveToFile(imageFilePath, renderEngine.getImage(), renderEngine.getViewWidth(), renderEngine.getViewHeight())) {
+        std::cout << "Failed to save image \"" << imageFilePath << "\": " << imageWriter.getSaveError() << std::endl;
+        return 4;
+    }
+
+    times.save = getMilliseconds(start);
+
+    std::cout << "Rendered " << frameCount << (frameCount == 1 ? " frame" : " frames") << " of " <<
+        renderEngine.getViewWidth() << "x" << renderEngine.getViewHeight() << " pixels" << std::endl;
+    std::cout << "load: " << times.load << " ms" << std::endl;
+
+    if (isModelStreamed) {
+        std::cout << "read: " << stageTotals.readTime / frameCount << " ms per frame" << std::endl;
+    }
+
+    std::cout << "transform: " << stageTotals.transformTime / frameCount << " ms per frame" << std::endl;
+    std::cout << "clip: " << stageTotals.clipTime / frameCount << " ms per frame" << std::endl;
+    std::cout << "light: " << stageTotals.lightTime / frameCount << " ms per frame" << std::endl;
+    std::cout << "raster: " << stageTotals.rasterTime / frameCount << " ms per frame" << std::endl;
+    std::cout << "shade: " << stageTotals.shadeTime / frameCount << " ms per frame" << std::endl;
+    std::cout << "frame: p50 " << frameTimeHistory.getPercentile(50) << " ms, p95 " << frameTimeHistory.getPercentile(95) <<
+        " ms, p99 " << frameTimeHistory.getPercentile(99) << " ms" << std::endl;
+    std::cout << "work: " << frameStatistics.triangleCount << " triangles, " << frameStatistics.clippedTriangleCount <<
+        " clipped, " << frameStatistics.fragmentCount << " fragments, " << frameStatistics.shadedPixelCount <<
+        " pixels shaded" << std::endl;
+    std::cout << "save: " << times.save << " ms" << std::endl;
+
+    return 0;
+}
+
+// Options follow the four paths, angles are given in degrees
+bool parseOptions(int argc, char *argv[], TransformEngine &transformEngine, RenderEngine &renderEngine, size_t &frameCount) {
+    for (int i = 5; i < argc; ++i) {
+        const std::string option = argv[i];
+        const int valueCount = argc - i - 1;
+
+        if (option == "--size" && valueCount >= 2) {
+            const double width = std::atof(argv[i+1]);
+            const double height = std::atof(argv[i+2]);
+
+            if (width < 1 || height < 1) {
+                return false;
+            }
+
+            transformEngine.setViewSize(width, height);
+            i = i + 2;
+        } else if (option == "--translation" && valueCount >= 3) {
+            transformEngine.setViewTranslation(std::atof(argv[i+1]), std::atof(argv[i+2]), std::atof(argv[i+3]));
+            i = i + 3;
+        } else if (option == "--rotation" && valueCount >= 3) {
+            transformEngine.setViewRotation(std::atof(argv[i+1]) * PI / 180, std::atof(argv[i+2]) * PI / 180,
+                std::atof(argv[i+3]) * PI / 180);
+            i = i + 3;
+        } else if (option == "--fovy" && valueCount >= 1) {
+            transformEngine.setPerspective(std::atof(argv[i+1]) * PI / 180, transformEngine.getZNear(), transformEngine.getZFar());
+            i = i + 1;
+        } else if (option == "--face-culling" && valueCount >= 1) {
+            const std::string mode = argv[i+1];
+
+            if (mode == "none") {
+                transformEngine.setFaceCullingMode(FaceCullingModes::NoFaces);
+            } else if (mode == "back") {
+                transformEngine.setFaceCullingMode(FaceCullingModes::BackFaces);
+            } else if (mode == "front") {
+                transformEngine.setFaceCullingMode(FaceCullingModes::FrontFaces);
+            } else {
+                return false;
+            }
+
+            i = i + 1;
+        } else if (option == "--half-space") {
+            renderEngine.setRasterizationMode(RasterizationModes::HalfSpace);
+        } else if (option == "--light-culling" && valueCount >= 1) {
+            const double lightCullingThreshold = std::atof(argv[i+1]);
+
+            if (lightCullingThreshold < 0) {
+                return false;
+            }
+
+            renderEngine.getLightEngine().setLightCullingThreshold(lightCullingThreshold);
+            i = i + 1;
+        } else if (option == "--no-level-of-detail") {
+            transformEngine.setLevelOfDetailEnabled(false);
+        } else if (option == "--threads" && valueCount >= 1) {
+            const size_t threadCount = std::strtoul(argv[i+1], nullptr, 10);
+
+            if (threadCount == 0) {
+                return false;
+            }
+
+            transformEngine.setThreadCount(threadCount);
+            renderEngine.setThreadCount(threadCount);
+            i = i + 1;
+        } else if (option == "--frames" && valueCount >= 1) {
+            frameCount = std::strtoul(argv[i+1], nullptr, 10);
+
+            if (frameCount == 0) {
+                return false;
+            }
+
+            i = i + 1;
+        } else {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+double getMilliseconds(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+void printUsage() {
+    std::cout << "Usage: offline-renderer model-file-path material-file-path light-sources-file-path image-file-path" << std::endl;
+    std::cout << "    [--size width height] [--translation x y z] [--rotation x y z] [--fovy degrees]" << std::endl;
+    std::cout << "    [--face-culling none|back|front] [--half-space] [--light-culling threshold] [--no-level-of-detail]" << std::endl;
+    std::cout << "    [--threads count] [--frames count]" << std::endl;
+}
@@ -0,0 +1,110 @@
+#include <cctype>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include "../text_scanner.h"
+
+// Pieces of numbers, separators and values near the limits of both precisions, which fuzzed lines are made of
+const char *const linePieces[] = {
+    "0", "1", "2", "5", "9", ".", "-", "+", "e", "E", " ", "\t", "\v", "\r", "x", "#", "123456789", "0000", "e-30", "e+38",
+    "e308", "e400", "3.14159265358979323846264338", "nan", "inf", "0x1p3", "1e-320"
+};
+
+const size_t valuesPerLine = 6;
+
+std::string generateLine(std::mt19937_64 &random);
+bool readLineWithStream(const std::string &line, Real values[valuesPerLine], bool isRead[valuesPerLine]);
+void printUsage();
+
+// Reads fuzzed lines with TextScanner and with std::istream, which parsed the text formats before, and exits with
+// code 2 if any line is skipped differently or any of its numbers is read differently, bit for bit
+int main(int argc, char *argv[]) {
+    const size_t lineCount = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 2000000;
+    std::mt19937_64 random(7);
+    size_t mismatchCount = 0;
+
+    if (argc > 2 || lineCount == 0) {
+        printUsage();
+        return 1;
+    }
+
+    for (size_t i = 0; i < lineCount; ++i) {
+        const std::string line = generateLine(random);
+        Real expectedValues[valuesPerLine];
+        bool isExpectedRead[valuesPerLine] = {};
+        const bool hasValues = readLineWithStream(line, expectedValues, isExpectedRead);
+        TextScanner scanner(line.data(), line.data() + line.size());
+        bool isMismatch = scanner.nextLine() != hasValues;
+
+        for (size_t j = 0; hasValues && !isMismatch && j < valuesPerLine; ++j) {
+            Real value;
+            const bool isRead = scanner.read(value);
+
+            isMismatch = isRead != isExpectedRead[j] || (isRead && std::memcmp(&value, &expectedValues[j], sizeof(value)) != 0);
+        }
+
+        if (isMismatch && ++mismatchCount <= 20) {
+            std::cout << "Line \"" << line << "\" is read differently" << std::endl;
+        }
+    }
+
+    std::cout << "Read " << lineCount << " fuzzed lines, " << mismatchCount << " of them differently than with streams" << std::endl;
+
+    return mismatchCount == 0 ? 0 : 2;
+}
+
+// Random pieces, a third of the lines start with a number printed with a random precision and exponent
+std::string generateLine(std::mt19937_64 &random) {
+    const size_t pieceCount = random() % 12;
+    std::string line;
+
+    if (random() % 3 == 0) {
+        char number[64];
+        const double mantissa = static_cast<double>(random() % 100000000) - 5e7;
+        const int precision = static_cast<int>(random() % 20) + 1;
+
+        std::snprintf(number, sizeof(number), "%.*g", precision, std::ldexp(mantissa, static_cast<int>(random() % 200) - 100));
+        line = std::string(number) + " ";
+    }
+
+    for (size_t i = 0; i < pieceCount; ++i) {
+        line += linePieces[random() % (sizeof(linePieces) / sizeof(linePieces[0]))];
+    }
+
+    return line;
+}
+
+// Trims the line and reads it like the stream based loaders did, returns false for empty lines and comments
+bool readLineWithStream(const std::string &line, Real values[valuesPerLine], bool isRead[valuesPerLine]) {
+    size_t begin = 0, end = line.size();
+
+    while (begin < end && std::isspace(static_cast<unsigned char>(line[begin]))) {
+        ++begin;
+    }
+
+    while (end > begin && std::isspace(static_cast<unsigned char>(line[end - 1]))) {
+        --end;
+    }
+
+    if (begin == end || line[begin] == '#') {
+        return false;
+    }
+
+    std::stringstream stream(line.substr(begin, end - begin));
+
+    for (size_t i = 0; i < valuesPerLine; ++i) {
+        stream >> values[i];
+        isRead[i] = !stream.fail();
+    }
+
+    return true;
+}
+
+void printUsage() {
+    std::cout << "Usage: text-scanner-check [line-count]" << std::endl;
+}
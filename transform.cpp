@@ -12,7 +12,7 @@ Matrix4x4 getIdentityMatrix() {
     return matrix;
 }
 
-Matrix4x4 getTranslationMatrix(double x, double y, double z) {
+Matrix4x4 getTranslationMatrix(Real x, Real y, Real z) {
     Matrix4x4 matrix = getIdentityMatrix();
 
     matrix.set(0, 3, x);
@@ -22,7 +22,17 @@ Matrix4x4 getTranslationMatrix(double x, double y, double z) {
     return matrix;
 }
 
-Matrix4x4 getRotationXMatrix(double angle) {
+Matrix4x4 getScaleMatrix(Real x, Real y, Real z) {
+    Matrix4x4 matrix = getIdentityMatrix();
+
+    matrix.set(0, 0, x);
+    matrix.set(1, 1, y);
+    matrix.set(2, 2, z);
+
+    return matrix;
+}
+
+Matrix4x4 getRotationXMatrix(Real angle) {
     Matrix4x4 matrix = getIdentityMatrix();
 
     matrix.set(1, 1, cos(angle));
@@ -33,7 +43,7 @@ Matrix4x4 getRotationXMatrix(double angle) {
     return matrix;
 }
 
-Matrix4x4 getRotationYMatrix(double angle) {
+Matrix4x4 getRotationYMatrix(Real angle) {
     Matrix4x4 matrix = getIdentityMatrix();
 
     matrix.set(0, 0, cos(angle));
@@ -44,7 +54,7 @@ Matrix4x4 getRotationYMatrix(double angle) {
     return matrix;
 }
 
-Matrix4x4 getRotationZMatrix(double angle) {
+Matrix4x4 getRotationZMatrix(Real angle) {
     Matrix4x4 matrix = getIdentityMatrix();
 
     matrix.set(0, 0, cos(angle));
@@ -55,11 +65,11 @@ Matrix4x4 getRotationZMatrix(double angle) {
     return matrix;
 }
 
-Matrix4x4 getRotationMatrix(double angle_x, double angle_y, double angle_z) {
+Matrix4x4 getRotationMatrix(Real angle_x, Real angle_y, Real angle_z) {
     return getRotationZMatrix(angle_z) * getRotationYMatrix(angle_y) * getRotationXMatrix(angle_x);
 }
 
-Matrix4x4 getPerspectiveMatrix(double fovy, double zNear, double zFar, double aspectRatio) {
+Matrix4x4 getPerspectiveMatrix(Real fovy, Real zNear, Real zFar, Real aspectRatio) {
     Matrix4x4 matrix;
 
     matrix.set(0, 0, 1 / tan(fovy / 2) / aspectRatio);
@@ -6,11 +6,12 @@
 #define PI 3.14159265
 
 Matrix4x4 getIdentityMatrix();
-Matrix4x4 getTranslationMatrix(double x, double y, double z);
-Matrix4x4 getRotationXMatrix(double angle);
-Matrix4x4 getRotationYMatrix(double angle);
-Matrix4x4 getRotationZMatrix(double angle);
-Matrix4x4 getRotationMatrix(double angle_x, double angle_y, double angle_z);
-Matrix4x4 getPerspectiveMatrix(double fovy, double zNear, double zFar, double aspectRatio = 1);
+Matrix4x4 getTranslationMatrix(Real x, Real y, Real z);
+Matrix4x4 getScaleMatrix(Real x, Real y, Real z);
+Matrix4x4 getRotationXMatrix(Real angle);
+Matrix4x4 getRotationYMatrix(Real angle);
+Matrix4x4 getRotationZMatrix(Real angle);
+Matrix4x4 getRotationMatrix(Real angle_x, Real angle_y, Real angle_z);
+Matrix4x4 getPerspectiveMatrix(Real fovy, Real zNear, Real zFar, Real aspectRatio = 1);
 
 #endif
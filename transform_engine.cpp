@@ -1,29 +1,85 @@
 #include <algorithm>
+#include <cmath>
+#include <cstring>
 #include <fstream>
-#include <sstream>
+#include <limits>
+#include "mesh_simplifier.h"
+#include "text_scanner.h"
 #include "transform_engine.h"
 
+// Levels of detail merge vertexes in grids from the finest to the coarsest resolution along the longest axis
+// of a mesh, keeping levels with at most the given ratio of the triangles of the finer level. An instance uses
+// the coarsest level whose error projects to at most the given number of pixels.
+const size_t levelOfDetailFinestResolution = 256;
+const size_t levelOfDetailCoarsestResolution = 8;
+const Real levelOfDetailTriangleRatio = 0.75;
+const Real levelOfDetailPixelError = 1;
+
+// Outcode bits of the planes of the view volume, and of the planes which a triangle must be clipped against when
+// one of its vertexes is outside of them, that is the near and far planes and the guard band planes
+const unsigned viewOutcodeMask = 0x3f;
+const unsigned clippingOutcodeMask = 0x3f0;
+
+// Bits of the clipping planes a clip space position is outside of, visible positions satisfy w < x, y, z < -w.
+// Bits 6 to 9 are the planes of the guard band along x and y. Positions with NaN coordinates are outside of both
+// planes of an axis.
+unsigned getOutcode(const Vector4 &position, Real guardBandScale) {
+    unsigned outcode = 0;
+
+    for (size_t i = 0; i < 3; ++i) {
+        if (!(position.c(i) > position.cw())) {
+            outcode |= 1u << (2 * i);
+        }
+
+        if (!(position.c(i) < -position.cw())) {
+            outcode |= 1u << (2 * i + 1);
+        }
+    }
+
+    for (size_t i = 0; i < 2; ++i) {
+        if (!(position.c(i) > position.cw() * guardBandScale)) {
+            outcode |= 1u << (2 * i + 6);
+        }
+
+        if (!(position.c(i) < -position.cw() * guardBandScale)) {
+            outcode |= 1u << (2 * i + 7);
+        }
+    }
+
+    return outcode;
+}
+
 TransformEngine::TransformEngine() {
     viewWidth = 512;
     viewHeight = 512;
     fovy = PI / 3;
     zNear = 0.1;
     zFar = 100;
+    faceCullingMode = FaceCullingModes::NoFaces;
+    degenerateCullingEnabled = true;
+    frustumCullingEnabled = true;
+    levelOfDetailEnabled = true;
+    culledTriangleCount = 0;
+    culledClusterCount = 0;
+    simplifiedInstanceCount = 0;
+    clippedTriangleCount = 0;
+    transformTime = 0;
+    clipTime = 0;
 }
 
 ClipEngine& TransformEngine::getClipEngine() {
     return clipEngine;
 }
 
-double TransformEngine::getViewWidth() const {
+Real TransformEngine::getViewWidth() const {
     return viewWidth;
 }
 
-double TransformEngine::getViewHeight() const {
+Real TransformEngine::getViewHeight() const {
     return viewHeight;
 }
 
-void TransformEngine::setViewSize(double viewWidth, double viewHeight) {
+void TransformEngine::setViewSize(Real viewWidth, Real viewHeight) {
     this->viewWidth = viewWidth;
     this->viewHeight = viewHeight;
 }
@@ -36,7 +92,7 @@ void TransformEngine::setViewTranslation(Vector4 viewTranslation) {
     this->viewTranslation = viewTranslation;
 }
 
-void TransformEngine::setViewTranslation(double x, double y, double z) {
+void TransformEngine::setViewTranslation(Real x, Real y, Real z) {
     setViewTranslation(Vector4(x, y, z));
 }
 
@@ -48,151 +104,895 @@ void TransformEngine::setViewRotation(Vector4 viewRotation) {
     this->viewRotation = viewRotation;
 }
 
-void TransformEngine::setViewRotation(double angle_x, double angle_y, double angle_z) {
+void TransformEngine::setViewRotation(Real angle_x, Real angle_y, Real angle_z) {
     setViewRotation(Vector4(angle_x, angle_y, angle_z));
 }
 
-double TransformEngine::getFovy() const {
+Real TransformEngine::getFovy() const {
     return fovy;
 }
 
-double TransformEngine::getZNear() const {
+Real TransformEngine::getZNear() const {
     return zNear;
 }
 
-double TransformEngine::getZFar() const {
+Real TransformEngine::getZFar() const {
     return zFar;
 }
 
-void TransformEngine::setPerspective(double fovy, double zNear, double zFar) {
+void TransformEngine::setPerspective(Real fovy, Real zNear, Real zFar) {
     this->fovy = fovy;
     this->zNear = zNear;
     this->zFar = zFar;
 }
 
+FaceCullingModes TransformEngine::getFaceCullingMode() const {
+    return faceCullingMode;
+}
+
+void TransformEngine::setFaceCullingMode(FaceCullingModes faceCullingMode) {
+    this->faceCullingMode = faceCullingMode;
+}
+
+bool TransformEngine::isDegenerateCullingEnabled() const {
+    return degenerateCullingEnabled;
+}
+
+void TransformEngine::setDegenerateCullingEnabled(bool degenerateCullingEnabled) {
+    this->degenerateCullingEnabled = degenerateCullingEnabled;
+}
+
+bool TransformEngine::isFrustumCullingEnabled() const {
+    return frustumCullingEnabled;
+}
+
+void TransformEngine::setFrustumCullingEnabled(bool frustumCullingEnabled) {
+    this->frustumCullingEnabled = frustumCullingEnabled;
+}
+
+bool TransformEngine::isLevelOfDetailEnabled() const {
+    return levelOfDetailEnabled;
+}
+
+void TransformEngine::setLevelOfDetailEnabled(bool levelOfDetailEnabled) {
+    this->levelOfDetailEnabled = levelOfDetailEnabled;
+    simplifyMeshes();
+}
+
+size_t TransformEngine::getThreadCount() const {
+    return threadPool.getThreadCount();
+}
+
+void TransformEngine::setThreadCount(size_t threadCount) {
+    threadPool.setThreadCount(threadCount);
+}
+
 void TransformEngine::loadModelFromVertexArray(std::vector<Vertex> &vertexArray) {
+    std::unique_ptr<Mesh> mesh(new Mesh());
+
+    mesh->loadFromVertexArray(vertexArray);
+    clearModel();
+    meshes.push_back(std::move(mesh));
+    buildMeshLevels();
+    simplifyMeshes();
+    addInstance(0, getIdentityMatrix(), getIdentityMatrix(), true);
+}
+
+void TransformEngine::loadBatchFromVertexArray(std::vector<Vertex> &vertexArray) {
+    std::unique_ptr<Mesh> mesh(new Mesh());
+
+    mesh->loadFromVertexArray(vertexArray);
     clearModel();
-    modelVertexes.insert(modelVertexes.end(), vertexArray.begin(), vertexArray.end());
+    meshes.push_back(std::move(mesh));
+    buildMeshLevels();
+    areMeshesSimplified[0] = true;
+    addInstance(0, getIdentityMatrix(), getIdentityMatrix(), true);
 }
 
 bool TransformEngine::loadModelFromBuffer(const std::string &buffer) {
     std::vector<Vertex> vertexArray;
-    std::stringstream stream(buffer);
-    std::string lineBuffer;
-
-    while (std::getline(stream, lineBuffer)) {
-        // Left trim
-        lineBuffer.erase(lineBuffer.begin(), std::find_if(lineBuffer.begin(), lineBuffer.end(), [](int c) {
-            return !std::isspace(c);
-        }));
-
-        // Right trim
-        lineBuffer.erase(std::find_if(lineBuffer.rbegin(), lineBuffer.rend(), [](int c) {
-            return !std::isspace(c);
-        }).base(), lineBuffer.end());
-
-        // Empty line or comment
-        if (lineBuffer.empty() || lineBuffer[0] == '#') {
-            continue;
-        }
 
-        Vertex vertex;
-        std::stringstream lineStream(lineBuffer);
+    loadError.clear();
 
-        lineStream >> vertex.position.x();
-        lineStream >> vertex.position.y();
-        lineStream >> vertex.position.z();
-        vertex.position.w() = 1.0;
+    if (!parseVertexArray(buffer, vertexArray)) {
+        return false;
+    }
 
-        if (lineStream.fail()) {
-            return false;
-        }
+    loadModelFromVertexArray(vertexArray);
+
+    return true;
+}
+
+bool TransformEngine::loadModelFromFile(const std::string &filePath) {
+    std::unique_ptr<Mesh> mesh(new Mesh());
+
+    loadError.clear();
+
+    if (filePath.empty()) {
+        return true;
+    }
+
+    if (!loadMeshFromFile(filePath, *mesh)) {
+        return false;
+    }
+
+    clearModel();
+    meshes.push_back(std::move(mesh));
+    buildMeshLevels();
+    simplifyMeshes();
+    addInstance(0, getIdentityMatrix(), getIdentityMatrix(), true);
+
+    return true;
+}
 
-        vertex.origin = vertex.position;
+bool TransformEngine::loadSceneFromBuffer(const std::string &buffer, const std::string &directoryPath) {
+    TextScanner scanner(buffer.data(), buffer.data() + buffer.size());
+    std::vector<std::string> meshPaths;
+    std::vector<size_t> sceneMeshes;
+    std::vector<std::unique_ptr<Mesh>> loadedMeshes;
+    std::vector<size_t> placementMeshes;
+    std::vector<Real> placementValues;
+    std::string keyword, path;
 
-        lineStream >> vertex.color.x();
-        lineStream >> vertex.color.y();
-        lineStream >> vertex.color.z();
-        vertex.color.w() = 1.0;
+    loadError.clear();
 
-        if (lineStream.fail()) {
-            vertex.color = Vector4(1.0, 1.0, 1.0, 1.0);
+    // Lines are either "mesh path" or "instance mesh x y z [angle_x angle_y angle_z [scale | scale_x scale_y scale_z]]",
+    // where mesh counts the mesh lines from 0 and angles are in degrees
+    while (scanner.nextLine()) {
+        const std::string line = "line " + std::to_string(scanner.getLineNumber());
+
+        if (!scanner.readWord(keyword)) {
+            continue;
         }
-        
-        lineStream >> vertex.normal.x();
-        lineStream >> vertex.normal.y();
-        lineStream >> vertex.normal.z();
-        vertex.normal.w() = 0.0;
 
-        if (lineStream.fail()) {
-            vertex.normal = Vector4(0.0, 0.0, 0.0, 0.0);
+        if (keyword == "mesh") {
+            if (!scanner.readRest(path)) {
+                loadError = line + " does not name a mesh";
+                return false;
+            }
+
+            if (!directoryPath.empty() && path[0] != '/') {
+                path = directoryPath + "/" + path;
+            }
+
+            // Meshes listed more than once are loaded once
+            const size_t loadedMesh = std::find(meshPaths.begin(), meshPaths.end(), path) - meshPaths.begin();
+
+            if (loadedMesh == meshPaths.size()) {
+                std::unique_ptr<Mesh> mesh(new Mesh());
+
+                if (!loadMeshFromFile(path, *mesh)) {
+                    loadError = line + ", mesh \"" + path + "\": " + loadError;
+                    return false;
+                }
+
+                meshPaths.push_back(path);
+                loadedMeshes.push_back(std::move(mesh));
+            }
+
+            sceneMeshes.push_back(loadedMesh);
+        } else if (keyword == "instance") {
+            Real values[10] = {};
+            size_t valueCount = 0;
+            std::string word;
+
+            while (scanner.readWord(word)) {
+                TextScanner valueScanner(word.data(), word.data() + word.size());
+                Real extra;
+
+                if (valueCount == 10 || !valueScanner.nextLine() || !valueScanner.read(values[valueCount]) ||
+                        valueScanner.read(extra)) {
+                    valueCount = 0;
+                    break;
+                }
+
+                ++valueCount;
+            }
+
+            const bool isMeshValid = valueCount > 0 && values[0] >= 0 && values[0] < sceneMeshes.size() &&
+                values[0] == std::floor(values[0]);
+
+            if (!isMeshValid || (valueCount != 4 && valueCount != 7 && valueCount != 8 && valueCount != 10)) {
+                loadError = line + " is not a valid instance";
+                return false;
+            }
+
+            placementMeshes.push_back(sceneMeshes[static_cast<size_t>(values[0])]);
+            placementValues.insert(placementValues.end(), values + 1, values + 10);
+
+            // Missing angles are zero and missing scales are one
+            Real *placement = &placementValues[placementValues.size() - 9];
+
+            if (valueCount < 10) {
+                std::fill(placement + 6, placement + 9, valueCount == 8 ? values[7] : Real(1));
+            }
+
+            if (placement[6] == 0 || placement[7] == 0 || placement[8] == 0) {
+                loadError = line + " scales an instance by zero";
+                return false;
+            }
+        } else {
+            loadError = line + " is neither a mesh nor an instance";
+            return false;
         }
-        
-        vertexArray.push_back(vertex);
     }
 
-    loadModelFromVertexArray(vertexArray);
+    clearModel();
+    meshes = std::move(loadedMeshes);
+    buildMeshLevels();
+    simplifyMeshes();
+
+    for (size_t i = 0; i < placementMeshes.size(); ++i) {
+        const Real *placement = &placementValues[9 * i];
+        const Matrix4x4 rotationMatrix = getRotationMatrix(placement[3] * PI / 180, placement[4] * PI / 180, placement[5] * PI / 180);
+
+        addInstance(placementMeshes[i],
+            getTranslationMatrix(placement[0], placement[1], placement[2]) * rotationMatrix *
+                getScaleMatrix(placement[6], placement[7], placement[8]),
+            rotationMatrix * getScaleMatrix(1 / placement[6], 1 / placement[7], 1 / placement[8]), false);
+    }
 
     return true;
 }
 
-bool TransformEngine::loadModelFromFile(const std::string &filePath) {
+bool TransformEngine::loadSceneFromFile(const std::string &filePath) {
+    loadError.clear();
+
     if (filePath.empty()) {
         return true;
     }
-    
+
     std::ifstream file(filePath);
 
     if (file.is_open()) {
         std::string buffer{std::istreambuf_iterator<char>(file), {}};
+        const size_t separator = filePath.find_last_of('/');
 
-        return loadModelFromBuffer(buffer);
+        return loadSceneFromBuffer(buffer, separator == std::string::npos ? "" : filePath.substr(0, separator));
     }
 
+    loadError = "cannot open the file";
+
     return false;
 }
 
+bool TransformEngine::isSceneFile(const std::string &filePath) {
+    const std::string extension = ".scene";
+
+    return filePath.size() > extension.size() && filePath.compare(filePath.size() - extension.size(), extension.size(), extension) == 0;
+}
+
+const std::string& TransformEngine::getLoadError() const {
+    return loadError;
+}
+
 void TransformEngine::clearModel() {
-    modelVertexes.clear();
+    meshes.clear();
+    simplifiedMeshes.clear();
+    meshLevels.clear();
+    meshBoundingSpheres.clear();
+    meshExtents.clear();
+    areMeshesSimplified.clear();
+    instances.clear();
     transformedVertexes.clear();
+    transformedIndexes.clear();
+}
+
+size_t TransformEngine::getMeshCount() const {
+    return meshes.size();
+}
+
+const Mesh& TransformEngine::getMesh(size_t mesh) const {
+    return *meshes[mesh];
+}
+
+size_t TransformEngine::getLevelCount(size_t mesh) const {
+    return meshLevels[mesh].size();
+}
+
+size_t TransformEngine::getInstanceCount() const {
+    return instances.size();
 }
 
 void TransformEngine::run() {
-    transformedVertexes.clear();
-    
-    if (modelVertexes.empty()) {
-        return;
-    }
+    const size_t chunkSize = 1024;
+    const size_t clusterTriangleCount = ClusterHierarchy::clusterTriangleCount;
+    const StageTimer runTimer;
 
-    transformedVertexes.insert(transformedVertexes.end(), modelVertexes.begin(), modelVertexes.end());
+    transformedVertexes.clear();
+    transformedIndexes.clear();
+    culledTriangleCount = 0;
+    culledClusterCount = 0;
+    simplifiedInstanceCount = 0;
+    clippedTriangleCount = 0;
 
-    Matrix4x4 transformMatrix = getPerspectiveMatrix(fovy, zNear, zFar, viewWidth / viewHeight) *
+    const Matrix4x4 transformMatrix = getPerspectiveMatrix(fovy, zNear, zFar, viewWidth / viewHeight) *
         getRotationMatrix(viewRotation.cx(), viewRotation.cy(), viewRotation.cz()) *
         getTranslationMatrix(viewTranslation.cx(), viewTranslation.cy(), viewTranslation.cz());
+    const Matrix4x4 viewMatrix = getRotationMatrix(viewRotation.cx(), viewRotation.cy(), viewRotation.cz()) *
+        getTranslationMatrix(viewTranslation.cx(), viewTranslation.cy(), viewTranslation.cz());
+
+    // Clusters of triangles outside of the view frustum are skipped before any of their vertexes is transformed.
+    // Vertex ranges of the visible clusters of an instance are merged and split into chunks in mesh order.
+    std::vector<size_t> clusters;
+    std::vector<std::pair<size_t, size_t>> vertexRanges;
+    size_t slotCount = 0;
+
+    instanceLevels.resize(instances.size());
+    instanceTransformMatrices.resize(instances.size());
+    instanceSlotOffsets.assign(instances.size(), SIZE_MAX);
+    visibleClusters.clear();
+    vertexChunks.clear();
+
+    for (size_t k = 0; k < instances.size(); ++k) {
+        instanceLevels[k] = levelOfDetailEnabled ? selectLevel(k, viewMatrix) : 0;
+        simplifiedInstanceCount += instanceLevels[k] > 0 ? 1 : 0;
+
+        const ClusterHierarchy &clusterHierarchy = getInstanceLevel(k).clusterHierarchy;
+
+        instanceTransformMatrices[k] = instances[k].isIdentity ? transformMatrix : transformMatrix * instances[k].modelMatrix;
+
+        if (frustumCullingEnabled) {
+            clusterHierarchy.getVisibleClusters(instanceTransformMatrices[k], clusters);
+        } else {
+            clusters.resize(clusterHierarchy.getClusterCount());
 
-    for (size_t i = 0; i < transformedVertexes.size(); ++i) {
-        transformedVertexes[i].position = transformMatrix * modelVertexes[i].position;
+            for (size_t i = 0; i < clusters.size(); ++i) {
+                clusters[i] = i;
+            }
+        }
+
+        culledClusterCount += clusterHierarchy.getClusterCount() - clusters.size();
+
+        if (clusters.empty()) {
+            continue;
+        }
+
+        vertexRanges.resize(clusters.size());
+
+        for (size_t i = 0; i < clusters.size(); ++i) {
+            visibleClusters.push_back(std::make_pair(k, clusters[i]));
+            clusterHierarchy.getClusterVertexRange(clusters[i], vertexRanges[i].first, vertexRanges[i].second);
+        }
+
+        std::sort(vertexRanges.begin(), vertexRanges.end());
+
+        for (size_t i = 0; i < vertexRanges.size();) {
+            const size_t first = vertexRanges[i].first;
+            size_t last = vertexRanges[i].second;
+
+            for (++i; i < vertexRanges.size() && vertexRanges[i].first <= last; ++i) {
+                last = std::max(last, vertexRanges[i].second);
+            }
+
+            for (size_t chunkFirst = first; chunkFirst < last; chunkFirst += chunkSize) {
+                vertexChunks.push_back(vertexChunk{ k, chunkFirst, std::min(chunkFirst + chunkSize, last) });
+            }
+        }
+
+        instanceSlotOffsets[k] = slotCount;
+        slotCount += getInstanceLevel(k).mesh->getVertexCount();
     }
 
-    for (size_t i = 0; i < transformedVertexes.size(); ++i) {
-        transformedVertexes[i].position = transformMatrix * modelVertexes[i].position;
+    // Vertex pass: every vertex of a visible cluster is transformed and, if it is between the near and far planes and
+    // inside of the guard band, mapped to the view
+    const size_t vertexChunkCount = vertexChunks.size();
+
+    clipPositions.resize(slotCount);
+    viewPositions.resize(slotCount);
+    outcodes.resize(slotCount);
+
+    const Real guardBandScale = clipEngine.getGuardBandScale();
+
+    threadPool.run(vertexChunkCount, [&](size_t chunk) {
+        const vertexChunk &c = vertexChunks[chunk];
+        const size_t slotOffset = instanceSlotOffsets[c.instance];
+
+        instanceTransformMatrices[c.instance].transformBatch(getInstanceLevel(c.instance).mesh->getPositions() + c.first,
+            &clipPositions[slotOffset + c.first], c.last - c.first);
+
+        for (size_t i = slotOffset + c.first; i < slotOffset + c.last; ++i) {
+            outcodes[i] = getOutcode(clipPositions[i], guardBandScale);
+
+            if ((outcodes[i] & clippingOutcodeMask) == 0) {
+                viewPositions[i] = toViewport(clipPositions[i]);
+            }
+        }
+    });
+
+    // Triangle pass: triangles of every visible cluster are rejected, culled or clipped. Triangles which cross only
+    // the side planes of the view volume within the guard band are not clipped, the rasterizer skips what is outside.
+    const size_t triangleChunkCount = visibleClusters.size();
+
+    chunkIndexes.resize(triangleChunkCount);
+    chunkClippedVertexes.resize(triangleChunkCount);
+    chunkCulledTriangleCounts.assign(triangleChunkCount, 0);
+    chunkClippedTriangleCounts.assign(triangleChunkCount, 0);
+    chunkTimes.assign(triangleChunkCount, 0);
+    chunkClipTimes.assign(triangleChunkCount, 0);
+
+    const StageTimer trianglePassTimer;
+
+    threadPool.run(triangleChunkCount, [&](size_t chunk) {
+        const StageTimer chunkTimer;
+        const instance &meshInstance = instances[visibleClusters[chunk].first];
+        const Mesh &mesh = *getInstanceLevel(visibleClusters[chunk].first).mesh;
+        const size_t cluster = visibleClusters[chunk].second;
+        const size_t slotOffset = instanceSlotOffsets[visibleClusters[chunk].first];
+        const size_t first = 3 * cluster * clusterTriangleCount;
+        const size_t last = 3 * std::min((cluster + 1) * clusterTriangleCount, mesh.getTriangleCount());
+        std::vector<size_t> &indexes = chunkIndexes[chunk];
+        std::vector<Vertex> &clippedVertexes = chunkClippedVertexes[chunk];
+        ClipPolygon polygon;
+
+        // Mirrored instances take the corners of their triangles in reverse order, so that front faces keep their winding
+        const size_t second = meshInstance.isMirrored ? 2 : 1;
+        const size_t third = meshInstance.isMirrored ? 1 : 2;
+
+        indexes.clear();
+        clippedVertexes.clear();
+
+        for (size_t i = first; i < last; i = i + 3) {
+            const size_t corners[3] = { i, i + second, i + third };
+            const size_t triangle[3] = {
+                slotOffset + mesh.getIndexes()[corners[0]], slotOffset + mesh.getIndexes()[corners[1]],
+                slotOffset + mesh.getIndexes()[corners[2]]
+            };
+            const unsigned outcodeA = outcodes[triangle[0]];
+            const unsigned outcodeB = outcodes[triangle[1]];
+            const unsigned outcodeC = outcodes[triangle[2]];
+
+            // Triangles entirely outside of one plane of the view volume are invisible
+            if ((outcodeA & outcodeB & outcodeC & viewOutcodeMask) != 0) {
+                continue;
+            }
+
+            if (((outcodeA | outcodeB | outcodeC) & clippingOutcodeMask) == 0) {
+                if (isCulled(viewPositions[triangle[0]], viewPositions[triangle[1]], viewPositions[triangle[2]])) {
+                    ++chunkCulledTriangleCounts[chunk];
+                } else {
+                    indexes.insert(indexes.end(), triangle, triangle + 3);
+                }
+
+                continue;
+            }
+
+            const StageTimer clipTimer;
+            Vertex clipInput[3];
+
+            for (size_t j = 0; j < 3; ++j) {
+                clipInput[j] = toWorld(meshInstance, mesh.getVertexes()[mesh.getIndexes()[corners[j]]]);
+                clipInput[j].position = clipPositions[triangle[j]];
+                clipInput[j].index = SIZE_MAX;
+            }
+
+            // The clipped polygon is drawn as a fan of triangles
+            clipEngine.clipTriangle(clipInput[0], clipInput[1], clipInput[2], polygon);
+
+            for (size_t j = 0; j < polygon.vertexCount; ++j) {
+                polygon.vertexes[j].position = toViewport(polygon.vertexes[j].position);
+            }
+
+            for (size_t j = 2; j < polygon.vertexCount; ++j) {
+                const size_t fan[3] = { 0, j - 1, j };
+
+                if (isCulled(polygon.vertexes[0].position, polygon.vertexes[j-1].position, polygon.vertexes[j].position)) {
+                    ++chunkCulledTriangleCounts[chunk];
+                    continue;
+                }
+
+                for (const size_t k : fan) {
+                    indexes.push_back(slotCount + clippedVertexes.size());
+                    clippedVertexes.push_back(polygon.vertexes[k]);
+                }
+            }
+
+            ++chunkClippedTriangleCounts[chunk];
+            chunkClipTimes[chunk] += clipTimer.getMilliseconds();
+        }
+
+        chunkTimes[chunk] = chunkTimer.getMilliseconds();
+    });
+
+    // Chunks are clipped on several threads, so clipping gets the part of the wall time of the pass which the threads
+    // spent clipping
+    const double trianglePassTime = trianglePassTimer.getMilliseconds();
+    double threadTime = 0, threadClipTime = 0;
+
+    for (size_t chunk = 0; chunk < triangleChunkCount; ++chunk) {
+        threadTime += chunkTimes[chunk];
+        threadClipTime += chunkClipTimes[chunk];
+        clippedTriangleCount += chunkClippedTriangleCounts[chunk];
     }
 
-    transformedVertexes = clipEngine.clipVertexes(transformedVertexes);
+    clipTime = threadTime > 0 ? trianglePassTime * threadClipTime / threadTime : 0;
 
-    for (size_t i = 0; i < transformedVertexes.size(); ++i) {
-        for (size_t j = 0; j < 4; ++j) {
-            transformedVertexes[i].position[j] /= transformedVertexes[i].position.w();
+    // Vertexes used by visible triangles are kept in instance and mesh order, followed by clipped vertexes in chunk order
+    std::vector<size_t> indexOffsets(triangleChunkCount + 1, 0);
+    std::vector<size_t> clippedVertexOffsets(triangleChunkCount + 1, 0);
+    size_t visibleVertexCount = 0;
+
+    vertexRemap.resize(slotCount);
+
+    for (const auto& c : vertexChunks) {
+        const size_t slotOffset = instanceSlotOffsets[c.instance];
+        std::fill(vertexRemap.begin() + slotOffset + c.first, vertexRemap.begin() + slotOffset + c.last, SIZE_MAX);
+    }
+
+    for (size_t chunk = 0; chunk < triangleChunkCount; ++chunk) {
+        for (const size_t index : chunkIndexes[chunk]) {
+            if (index < slotCount) {
+                vertexRemap[index] = 0;
+            }
         }
+
+        indexOffsets[chunk + 1] = indexOffsets[chunk] + chunkIndexes[chunk].size();
+        clippedVertexOffsets[chunk + 1] = clippedVertexOffsets[chunk] + chunkClippedVertexes[chunk].size();
+        culledTriangleCount += chunkCulledTriangleCounts[chunk];
     }
 
-    for (size_t i = 0; i < transformedVertexes.size(); ++i) {
-        transformedVertexes[i].position.x() = (1 + transformedVertexes[i].position.cx()) * viewWidth / 2;
-        transformedVertexes[i].position.y() = (1 + transformedVertexes[i].position.cy()) * viewHeight / 2;
-        transformedVertexes[i].position.z() = (1 + transformedVertexes[i].position.cz()) / 2;
+    for (const auto& c : vertexChunks) {
+        const size_t slotOffset = instanceSlotOffsets[c.instance];
+
+        for (size_t i = slotOffset + c.first; i < slotOffset + c.last; ++i) {
+            if (vertexRemap[i] != SIZE_MAX) {
+                vertexRemap[i] = visibleVertexCount++;
+            }
+        }
     }
+
+    transformedVertexes.resize(visibleVertexCount + clippedVertexOffsets.back());
+    transformedIndexes.resize(indexOffsets.back());
+
+    threadPool.run(vertexChunkCount, [&](size_t chunk) {
+        const vertexChunk &c = vertexChunks[chunk];
+        const instance &meshInstance = instances[c.instance];
+        const meshLevel &level = getInstanceLevel(c.instance);
+        const Vertex *meshVertexes = level.mesh->getVertexes();
+        const size_t slotOffset = instanceSlotOffsets[c.instance];
+
+        for (size_t i = c.first; i < c.last; ++i) {
+            if (vertexRemap[slotOffset + i] != SIZE_MAX) {
+                Vertex &vertex = transformedVertexes[vertexRemap[slotOffset + i]];
+                vertex = toWorld(meshInstance, meshVertexes[i]);
+                vertex.position = viewPositions[slotOffset + i];
+                // Only a loaded model, the one instance without a placement, is lit through the cache
+                vertex.index = meshInstance.isIdentity ? level.vertexOffset + i : SIZE_MAX;
+            }
+        }
+    });
+
+    threadPool.run(triangleChunkCount, [&](size_t chunk) {
+        const size_t clippedVertexOffset = visibleVertexCount + clippedVertexOffsets[chunk];
+
+        for (size_t i = 0; i < chunkIndexes[chunk].size(); ++i) {
+            const size_t index = chunkIndexes[chunk][i];
+            transformedIndexes[indexOffsets[chunk] + i] = index < slotCount ? vertexRemap[index] : clippedVertexOffset + (index - slotCount);
+        }
+
+        std::copy(chunkClippedVertexes[chunk].begin(), chunkClippedVertexes[chunk].end(), transformedVertexes.begin() + clippedVertexOffset);
+    });
+
+    transformTime = runTimer.getMilliseconds() - clipTime;
 }
 
 const std::vector<Vertex>& TransformEngine::getTransformedVertexes() const {
     return transformedVertexes;
 }
+
+const std::vector<size_t>& TransformEngine::getTransformedIndexes() const {
+    return transformedIndexes;
+}
+
+size_t TransformEngine::getCulledTriangleCount() const {
+    return culledTriangleCount;
+}
+
+size_t TransformEngine::getCulledClusterCount() const {
+    return culledClusterCount;
+}
+
+size_t TransformEngine::getSimplifiedInstanceCount() const {
+    return simplifiedInstanceCount;
+}
+
+size_t TransformEngine::getClippedTriangleCount() const {
+    return clippedTriangleCount;
+}
+
+double TransformEngine::getTransformTime() const {
+    return transformTime;
+}
+
+double TransformEngine::getClipTime() const {
+    return clipTime;
+}
+
+// Divides a clip space position by w and maps it to the view
+Vector4 TransformEngine::toViewport(Vector4 position) const {
+    for (size_t j = 0; j < 4; ++j) {
+        position[j] /= position.w();
+    }
+
+    position.x() = (1 + position.cx()) * viewWidth / 2;
+    position.y() = (1 + position.cy()) * viewHeight / 2;
+    position.z() = (1 + position.cz()) / 2;
+
+    return position;
+}
+
+bool TransformEngine::isCulled(const Vector4 &a, const Vector4 &b, const Vector4 &c) const {
+    // After the viewport transform front faces have negative area
+    const Real area = (b.cx() - a.cx()) * (c.cy() - a.cy()) - (c.cx() - a.cx()) * (b.cy() - a.cy());
+
+    if (faceCullingMode == FaceCullingModes::BackFaces && area > 0) {
+        return true;
+    }
+
+    if (faceCullingMode == FaceCullingModes::FrontFaces && area < 0) {
+        return true;
+    }
+
+    if (degenerateCullingEnabled) {
+        const Real left = std::ceil(std::min(std::min(a.cx(), b.cx()), c.cx()));
+        const Real right = std::floor(std::max(std::max(a.cx(), b.cx()), c.cx()));
+        const Real top = std::ceil(std::min(std::min(a.cy(), b.cy()), c.cy()));
+        const Real bottom = std::floor(std::max(std::max(a.cy(), b.cy()), c.cy()));
+
+        if (area == 0 || left > right || top > bottom) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool TransformEngine::parseVertexArray(const std::string &buffer, std::vector<Vertex> &vertexArray) {
+    const size_t pieceSize = 1 << 18;
+    const size_t pieceCount = std::max<size_t>(buffer.size() / pieceSize, 1);
+    const char *bufferEnd = buffer.data() + buffer.size();
+    std::vector<const char*> pieceBegins(pieceCount + 1, bufferEnd);
+    std::vector<std::vector<Vertex>> pieceVertexArrays(pieceCount);
+    std::vector<size_t> pieceLineCounts(pieceCount, 0);
+    std::vector<size_t> pieceErrorLines(pieceCount, 0);
+
+    // Large buffers are parsed in pieces which end right after a line feed, so that no line is split
+    pieceBegins[0] = buffer.data();
+
+    for (size_t i = 1; i < pieceCount; ++i) {
+        const char *begin = std::max(buffer.data() + i * (buffer.size() / pieceCount), pieceBegins[i-1]);
+        const char *newLine = static_cast<const char*>(std::memchr(begin, '\n', bufferEnd - begin));
+        pieceBegins[i] = newLine != nullptr ? newLine + 1 : bufferEnd;
+    }
+
+    threadPool.run(pieceCount, [&](size_t piece) {
+        TextScanner scanner(pieceBegins[piece], pieceBegins[piece + 1]);
+        std::vector<Vertex> &pieceVertexArray = pieceVertexArrays[piece];
+
+        while (scanner.nextLine()) {
+            Vertex vertex;
+
+            if (!scanner.readVertex(vertex)) {
+                pieceErrorLines[piece] = scanner.getLineNumber();
+                return;
+            }
+
+            pieceVertexArray.push_back(vertex);
+        }
+
+        pieceLineCounts[piece] = scanner.getLineNumber();
+    });
+
+    // Pieces before the first failed one were parsed completely, so their line counts locate the bad line
+    size_t vertexCount = 0;
+    size_t lineOffset = 0;
+
+    for (size_t i = 0; i < pieceCount; ++i) {
+        if (pieceErrorLines[i] != 0) {
+            loadError = "line " + std::to_string(lineOffset + pieceErrorLines[i]) + " is not a valid vertex";
+            return false;
+        }
+
+        vertexCount += pieceVertexArrays[i].size();
+        lineOffset += pieceLineCounts[i];
+    }
+
+    vertexArray.clear();
+    vertexArray.reserve(vertexCount);
+
+    for (const auto& pieceVertexArray : pieceVertexArrays) {
+        vertexArray.insert(vertexArray.end(), pieceVertexArray.begin(), pieceVertexArray.end());
+    }
+
+    return true;
+}
+
+bool TransformEngine::loadMeshFromFile(const std::string &filePath, Mesh &mesh) {
+    if (Mesh::isBinaryFile(filePath)) {
+        if (!mesh.loadFromBinaryFile(filePath)) {
+            loadError = mesh.getLoadError();
+            return false;
+        }
+
+        return true;
+    }
+
+    std::ifstream file(filePath);
+
+    if (file.is_open()) {
+        std::string buffer{std::istreambuf_iterator<char>(file), {}};
+        std::vector<Vertex> vertexArray;
+
+        if (!parseVertexArray(buffer, vertexArray)) {
+            return false;
+        }
+
+        mesh.loadFromVertexArray(vertexArray);
+
+        return true;
+    }
+
+    loadError = "cannot open the file";
+
+    return false;
+}
+
+// Every mesh gets its own level with its cluster hierarchy and its bounds, simplified levels are built by simplifyMesh
+void TransformEngine::buildMeshLevels() {
+    simplifiedMeshes.clear();
+    meshLevels.assign(meshes.size(), std::vector<meshLevel>());
+    meshBoundingSpheres.assign(meshes.size(), Vector4());
+    meshExtents.assign(meshes.size(), 0);
+    areMeshesSimplified.assign(meshes.size(), false);
+
+    for (size_t i = 0; i < meshes.size(); ++i) {
+        const Mesh &mesh = *meshes[i];
+        const Vector4 *positions = mesh.getPositions();
+        Real minimum[3], maximum[3];
+
+        meshLevels[i].push_back(meshLevel{ &mesh, ClusterHierarchy(), 0, 0 });
+        meshLevels[i].back().clusterHierarchy.build(mesh);
+
+        if (mesh.getVertexCount() == 0) {
+            continue;
+        }
+
+        std::fill(minimum, minimum + 3, std::numeric_limits<Real>::infinity());
+        std::fill(maximum, maximum + 3, -std::numeric_limits<Real>::infinity());
+
+        for (size_t v = 0; v < mesh.getVertexCount(); ++v) {
+            for (size_t j = 0; j < 3; ++j) {
+                minimum[j] = std::min(minimum[j], positions[v].c(j));
+                maximum[j] = std::max(maximum[j], positions[v].c(j));
+            }
+        }
+
+        const Vector4 center((minimum[0] + maximum[0]) / 2, (minimum[1] + maximum[1]) / 2, (minimum[2] + maximum[2]) / 2);
+        Real radius = 0;
+
+        for (size_t v = 0; v < mesh.getVertexCount(); ++v) {
+            const Vector4 offset(positions[v].cx() - center.cx(), positions[v].cy() - center.cy(), positions[v].cz() - center.cz());
+            radius = std::max(radius, offset.getLength());
+        }
+
+        meshBoundingSpheres[i] = Vector4(center.cx(), center.cy(), center.cz(), radius);
+        meshExtents[i] = std::max(std::max(maximum[0] - minimum[0], maximum[1] - minimum[1]), maximum[2] - minimum[2]);
+    }
+}
+
+// Meshes are simplified when loaded or when levels of detail get enabled, never in a frame and never while disabled
+void TransformEngine::simplifyMeshes() {
+    for (size_t i = 0; levelOfDetailEnabled && i < meshes.size(); ++i) {
+        if (!areMeshesSimplified[i]) {
+            simplifyMesh(i);
+        }
+    }
+}
+
+void TransformEngine::simplifyMesh(size_t mesh) {
+    MeshSimplifier meshSimplifier;
+
+    areMeshesSimplified[mesh] = true;
+
+    if (meshes[mesh]->getVertexCount() == 0) {
+        return;
+    }
+
+    // Each level merges vertexes in cells twice as large as the previous one and is simplified from it, so
+    // its error is at most the sum of the distances vertexes moved by in every simplification up to it. Levels which
+    // save too few triangles are not kept.
+    for (size_t resolution = levelOfDetailFinestResolution; resolution >= levelOfDetailCoarsestResolution; resolution /= 2) {
+        const meshLevel &finerLevel = meshLevels[mesh].back();
+        const Real cellSize = meshExtents[mesh] / resolution;
+        std::unique_ptr<Mesh> simplifiedMesh(new Mesh());
+
+        if (!meshSimplifier.simplify(*finerLevel.mesh, cellSize, *simplifiedMesh)) {
+            break;
+        }
+
+        if (simplifiedMesh->getTriangleCount() > levelOfDetailTriangleRatio * finerLevel.mesh->getTriangleCount()) {
+            continue;
+        }
+
+        const Real error = finerLevel.error + meshSimplifier.getMaximumDisplacement();
+
+        meshLevels[mesh].push_back(meshLevel{ simplifiedMesh.get(), ClusterHierarchy(), error,
+            finerLevel.vertexOffset + finerLevel.mesh->getVertexCount() });
+        meshLevels[mesh].back().clusterHierarchy.build(*simplifiedMesh);
+        simplifiedMeshes.push_back(std::move(simplifiedMesh));
+    }
+}
+
+void TransformEngine::addInstance(size_t mesh, const Matrix4x4 &modelMatrix, const Matrix4x4 &normalMatrix, bool isIdentity) {
+    instance meshInstance;
+
+    meshInstance.mesh = mesh;
+    meshInstance.isIdentity = isIdentity;
+    meshInstance.modelMatrix = modelMatrix;
+    meshInstance.normalMatrix = normalMatrix;
+    meshInstance.scale = 0;
+
+    Vector4 axes[3];
+
+    for (size_t j = 0; j < 3; ++j) {
+        axes[j] = Vector4(modelMatrix.get(0, j), modelMatrix.get(1, j), modelMatrix.get(2, j));
+        meshInstance.scale = std::max(meshInstance.scale, axes[j].getLength());
+    }
+
+    // A negative determinant of the model matrix mirrors the mesh
+    const Real determinant =
+        axes[0].cx() * (axes[1].cy() * axes[2].cz() - axes[1].cz() * axes[2].cy()) -
+        axes[0].cy() * (axes[1].cx() * axes[2].cz() - axes[1].cz() * axes[2].cx()) +
+        axes[0].cz() * (axes[1].cx() * axes[2].cy() - axes[1].cy() * axes[2].cx());
+    meshInstance.isMirrored = determinant < 0;
+
+    instances.push_back(meshInstance);
+}
+
+size_t TransformEngine::selectLevel(size_t instance, const Matrix4x4 &viewMatrix) const {
+    const std::vector<meshLevel> &levels = meshLevels[instances[instance].mesh];
+    const Vector4 &boundingSphere = meshBoundingSpheres[instances[instance].mesh];
+    Vector4 center(boundingSphere.cx(), boundingSphere.cy(), boundingSphere.cz(), 1);
+
+    if (!instances[instance].isIdentity) {
+        center = instances[instance].modelMatrix * center;
+    }
+
+    center = viewMatrix * center;
+
+    // The error is projected at the point of the bounding sphere nearest to the viewer
+    const Real distance = Vector4(center.cx(), center.cy(), center.cz()).getLength() -
+        boundingSphere.cw() * instances[instance].scale;
+    const Real pixelsPerUnit = viewHeight / (2 * distance * std::tan(fovy / 2));
+
+    if (!(distance > zNear) || !std::isfinite(pixelsPerUnit)) {
+        return 0;
+    }
+
+    size_t level = 0;
+
+    while (level + 1 < levels.size() &&
+            levels[level + 1].error * instances[instance].scale * pixelsPerUnit <= levelOfDetailPixelError) {
+        ++level;
+    }
+
+    return level;
+}
+
+const TransformEngine::meshLevel& TransformEngine::getInstanceLevel(size_t instance) const {
+    return meshLevels[instances[instance].mesh][instanceLevels[instance]];
+}
+
+Vertex TransformEngine::toWorld(const instance &meshInstance, Vertex vertex) const {
+    if (meshInstance.isIdentity) {
+        return vertex;
+    }
+
+    const Vector4 origin = meshInstance.modelMatrix * Vector4(vertex.origin.cx(), vertex.origin.cy(), vertex.origin.cz(), 1);
+    const Vector4 normal = meshInstance.normalMatrix * Vector4(vertex.normal.cx(), vertex.normal.cy(), vertex.normal.cz(), 0);
+
+    vertex.origin = Vector4(origin.cx(), origin.cy(), origin.cz(), vertex.origin.cw());
+    vertex.normal = Vector4(normal.cx(), normal.cy(), normal.cz(), vertex.normal.cw());
+
+    return vertex;
+}
@@ -1,11 +1,24 @@
 #ifndef TRANSFORM_ENGINE_H
 #define TRANSFORM_ENGINE_H
 
+#include <memory>
+#include <string>
 #include <vector>
 #include "clip_engine.h"
+#include "cluster_hierarchy.h"
+#include "mesh.h"
+#include "stage_timer.h"
+#include "thread_pool.h"
 #include "transform.h"
 #include "vertex.h"
 
+// Front faces are counter clockwise when seen from the outside of a model
+enum FaceCullingModes {
+    NoFaces,
+    BackFaces,
+    FrontFaces
+};
+
 class TransformEngine {
     
 public:
@@ -14,42 +27,173 @@ public:
 
     ClipEngine& getClipEngine();    
 
-    double getViewWidth() const;
-    double getViewHeight() const;
-    void setViewSize(double viewWidth, double viewHeight);
+    Real getViewWidth() const;
+    Real getViewHeight() const;
+    void setViewSize(Real viewWidth, Real viewHeight);
 
     Vector4 getViewTranslation() const;
     void setViewTranslation(Vector4 viewTranslation);
-    void setViewTranslation(double x, double y, double z);
+    void setViewTranslation(Real x, Real y, Real z);
 
     Vector4 getViewRotation() const;
     void setViewRotation(Vector4 viewRotation);
-    void setViewRotation(double angle_x, double angle_y, double angle_z);
+    void setViewRotation(Real angle_x, Real angle_y, Real angle_z);
+
+    Real getFovy() const;
+    Real getZNear() const;
+    Real getZFar() const;
+    void setPerspective(Real fovy, Real zNear, Real zFar);
+
+    FaceCullingModes getFaceCullingMode() const;
+    void setFaceCullingMode(FaceCullingModes faceCullingMode);
+
+    // Degenerate triangles have zero area or do not cover any pixel center
+    bool isDegenerateCullingEnabled() const;
+    void setDegenerateCullingEnabled(bool degenerateCullingEnabled);
 
-    double getFovy() const;
-    double getZNear() const;
-    double getZFar() const;
-    void setPerspective(double fovy, double zNear, double zFar);
+    // Clusters of triangles are tested against the view frustum before their vertexes are transformed
+    bool isFrustumCullingEnabled() const;
+    void setFrustumCullingEnabled(bool frustumCullingEnabled);
 
+    // Meshes get simplified levels of detail when loaded with level of detail enabled, or when it gets enabled, never
+    // in run. Each frame every instance uses the coarsest level whose vertexes moved by less than a pixel on the
+    // screen, so distant instances do not cost a triangle per pixel.
+    bool isLevelOfDetailEnabled() const;
+    void setLevelOfDetailEnabled(bool levelOfDetailEnabled);
+
+    size_t getThreadCount() const;
+    void setThreadCount(size_t threadCount);
+
+    // A model is a single mesh drawn once where it is
     void loadModelFromVertexArray(std::vector<Vertex> &vertexArray);
+    // A batch is a model drawn for one frame only, like a part of a streamed model. It gets no simplified levels of
+    // detail, they would be built again every frame and could open seams along the borders of batches.
+    void loadBatchFromVertexArray(std::vector<Vertex> &vertexArray);
     bool loadModelFromBuffer(const std::string &buffer);
+    // Files starting with the binary mesh magic are mapped, other files are parsed as text
     bool loadModelFromFile(const std::string &filePath);
+
+    // A scene lists meshes by path and places instances of them, each mesh is loaded once however many
+    // instances it has. Paths are relative to the scene directory.
+    bool loadSceneFromBuffer(const std::string &buffer, const std::string &directoryPath = "");
+    bool loadSceneFromFile(const std::string &filePath);
+    // Scene files end with .scene, other files are models
+    static bool isSceneFile(const std::string &filePath);
+
+    // Reason the last load failed, naming the first bad line of text files
+    const std::string& getLoadError() const;
     void clearModel();
 
+    size_t getMeshCount() const;
+    const Mesh& getMesh(size_t mesh) const;
+    size_t getInstanceCount() const;
+
+    // Meshes loaded with level of detail disabled have only one level until it gets enabled
+    size_t getLevelCount(size_t mesh) const;
+
+    // Transformed vertexes are the visible vertexes of every instance followed by vertexes created by clipping,
+    // every 3 consecutive transformed indexes form a visible triangle. Vertex origins and normals are in world space.
     void run();
     const std::vector<Vertex>& getTransformedVertexes() const;
+    const std::vector<size_t>& getTransformedIndexes() const;
+    size_t getCulledTriangleCount() const;
+    size_t getCulledClusterCount() const;
+    size_t getSimplifiedInstanceCount() const; // Instances drawn with a simplified level in the last run
+    size_t getClippedTriangleCount() const; // Triangles which crossed the near or far plane or the guard band
+
+    // Wall time of the last run in milliseconds, split into clipping and the rest of it
+    double getTransformTime() const;
+    double getClipTime() const;
+
+private:
+
+    // Placement of a mesh, normals are transformed by the inverse transpose of the model matrix
+    struct instance {
+        size_t mesh;
+        bool isIdentity;
+        Matrix4x4 modelMatrix;
+        Matrix4x4 normalMatrix;
+        Real scale; // Largest scale of the model matrix along any axis
+        bool isMirrored; // Negative scales flip the winding of the triangles
+    };
+
+    // Level of detail of a mesh, level 0 is the loaded mesh
+    struct meshLevel {
+        const Mesh *mesh;
+        ClusterHierarchy clusterHierarchy;
+        Real error; // Largest distance a vertex could have moved by in simplification
+        size_t vertexOffset; // Vertex count of the finer levels
+    };
+
+    // Vertexes of an instance from first to last - 1
+    struct vertexChunk {
+        size_t instance;
+        size_t first;
+        size_t last;
+    };
+
+    bool parseVertexArray(const std::string &buffer, std::vector<Vertex> &vertexArray);
+    bool loadMeshFromFile(const std::string &filePath, Mesh &mesh);
+    void buildMeshLevels();
+    void simplifyMeshes();
+    void simplifyMesh(size_t mesh);
+    void addInstance(size_t mesh, const Matrix4x4 &modelMatrix, const Matrix4x4 &normalMatrix, bool isIdentity);
+    size_t selectLevel(size_t instance, const Matrix4x4 &viewMatrix) const;
+    const meshLevel& getInstanceLevel(size_t instance) const;
+    Vertex toWorld(const instance &meshInstance, Vertex vertex) const;
+    Vector4 toViewport(Vector4 position) const;
+    bool isCulled(const Vector4 &a, const Vector4 &b, const Vector4 &c) const;
 
 private:
 
     ClipEngine clipEngine;
+    ThreadPool threadPool;
 
-    double viewWidth, viewHeight;
+    Real viewWidth, viewHeight;
     Vector4 viewTranslation;
     Vector4 viewRotation;
-    double fovy, zNear, zFar;
+    Real fovy, zNear, zFar;
+    FaceCullingModes faceCullingMode;
+    bool degenerateCullingEnabled;
+    bool frustumCullingEnabled;
+    bool levelOfDetailEnabled;
+    size_t culledTriangleCount;
+    size_t culledClusterCount;
+    size_t simplifiedInstanceCount;
+    size_t clippedTriangleCount;
+    double transformTime;
+    double clipTime;
+    std::string loadError;
 
-    std::vector<Vertex> modelVertexes;
+    std::vector<std::unique_ptr<Mesh>> meshes;
+    std::vector<std::unique_ptr<Mesh>> simplifiedMeshes;
+    std::vector<std::vector<meshLevel>> meshLevels;
+    std::vector<Vector4> meshBoundingSpheres; // Center and radius as w
+    std::vector<Real> meshExtents; // Largest size along any axis
+    std::vector<bool> areMeshesSimplified; // Simplified levels are built or not needed
+    std::vector<instance> instances;
     std::vector<Vertex> transformedVertexes;
+    std::vector<size_t> transformedIndexes;
+
+    std::vector<size_t> instanceLevels;
+
+    // Every vertex of a visible cluster is transformed once per instance. Vertexes of an instance with a visible cluster
+    // get slots from the instance slot offset on, triangles of a chunk refer to them by their slot and to vertexes
+    // the chunk created by clipping by the slot count plus their index in the chunk.
+    std::vector<Matrix4x4> instanceTransformMatrices;
+    std::vector<size_t> instanceSlotOffsets;
+    std::vector<std::pair<size_t, size_t>> visibleClusters;
+    std::vector<vertexChunk> vertexChunks;
+    std::vector<Vector4> clipPositions;
+    std::vector<Vector4> viewPositions;
+    std::vector<unsigned> outcodes;
+    std::vector<size_t> vertexRemap;
+    std::vector<std::vector<size_t>> chunkIndexes;
+    std::vector<std::vector<Vertex>> chunkClippedVertexes;
+    std::vector<size_t> chunkCulledTriangleCounts;
+    std::vector<size_t> chunkClippedTriangleCounts;
+    std::vector<double> chunkTimes;
+    std::vector<double> chunkClipTimes;
 };
 
 #endif
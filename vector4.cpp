@@ -3,65 +3,88 @@
 #include <sstream>
 #include "vector4.h"
 
-Vector4::Vector4(double x, double y, double z, double w) {
+template <typename T>
+BasicVector4<T>::BasicVector4(T x, T y, T z, T w) {
     data[0] = x;
     data[1] = y;
     data[2] = z;
     data[3] = w;
 }
 
-double& Vector4::operator[](size_t const &i) {
+template <typename T>
+T& BasicVector4<T>::operator[](size_t const &i) {
     return data[i];
 }
 
-double Vector4::c(size_t const &i) const {
+template <typename T>
+T BasicVector4<T>::c(size_t const &i) const {
     return data[i];
 }
 
-double& Vector4::x() {
+template <typename T>
+T& BasicVector4<T>::x() {
     return data[0];
 }
 
-double& Vector4::y() {
+template <typename T>
+T& BasicVector4<T>::y() {
     return data[1];
 }
 
-double& Vector4::z() {
+template <typename T>
+T& BasicVector4<T>::z() {
     return data[2];
 }
 
-double& Vector4::w() {
+template <typename T>
+T& BasicVector4<T>::w() {
     return data[3];
 }
 
-double Vector4::cx() const {
+template <typename T>
+T BasicVector4<T>::cx() const {
     return data[0];
 }
 
-double Vector4::cy() const {
+template <typename T>
+T BasicVector4<T>::cy() const {
     return data[1];
 }
 
-double Vector4::cz() const {
+template <typename T>
+T BasicVector4<T>::cz() const {
     return data[2];
 }
 
-double Vector4::cw() const {
+template <typename T>
+T BasicVector4<T>::cw() const {
     return data[3];
 }
 
-double Vector4::getLength() const {
-    double sumOfSquares = 0;
+template <typename T>
+bool BasicVector4<T>::operator==(const BasicVector4 &other) const {
+    return data[0] == other.data[0] && data[1] == other.data[1] && data[2] == other.data[2] && data[3] == other.data[3];
+}
+
+template <typename T>
+bool BasicVector4<T>::operator!=(const BasicVector4 &other) const {
+    return !(*this == other);
+}
+
+template <typename T>
+T BasicVector4<T>::getLength() const {
+    T sumOfSquares = 0;
 
     for (size_t i = 0; i < 4; ++i) {
         sumOfSquares += data[i] * data[i];
     }
 
-    return sqrt(sumOfSquares);
+    return std::sqrt(sumOfSquares);
 }
 
-void Vector4::normalize() {
-    double length = getLength();
+template <typename T>
+void BasicVector4<T>::normalize() {
+    T length = getLength();
 
     if (length == 0.0) {
         return;
@@ -72,7 +95,8 @@ void Vector4::normalize() {
     }
 }
 
-std::string Vector4::toString() const {
+template <typename T>
+std::string BasicVector4<T>::toString() const {
     std::ostringstream stream;
 
     for (size_t i = 0; i < 4; ++i) {
@@ -83,3 +107,6 @@ std::string Vector4::toString() const {
 
     return stream.str();
 }
+
+template class BasicVector4<float>;
+template class BasicVector4<double>;
@@ -2,35 +2,43 @@
 #define VECTOR4_H
 
 #include <string>
+#include "real.h"
 
-class Vector4 {
+// Defined for float and double only
+template <typename T>
+class BasicVector4 {
 
 public:
 
-    Vector4(double x = 0, double y = 0, double z = 0, double w = 0);
+    BasicVector4(T x = 0, T y = 0, T z = 0, T w = 0);
 
-    double& operator[](size_t const &i);
-    double c(size_t const &i) const;
+    T& operator[](size_t const &i);
+    T c(size_t const &i) const;
 
-    double& x();
-    double& y();
-    double& z();
-    double& w();
+    T& x();
+    T& y();
+    T& z();
+    T& w();
 
-    double cx() const;
-    double cy() const;
-    double cz() const;
-    double cw() const;
+    T cx() const;
+    T cy() const;
+    T cz() const;
+    T cw() const;
 
-    double getLength() const;
+    bool operator==(const BasicVector4 &other) const;
+    bool operator!=(const BasicVector4 &other) const;
+
+    T getLength() const;
     void normalize();
 
     std::string toString() const;
 
 private:
 
-    double data[4];
+    T data[4];
 
 };
 
+typedef BasicVector4<Real> Vector4;
+
 #endif
@@ -1,6 +1,7 @@
 #ifndef VERTEX_H
 #define VERTEX_H
 
+#include <cstdint>
 #include "vector4.h"
 
 struct Vertex {
@@ -8,6 +9,11 @@ struct Vertex {
     Vector4 position;
     Vector4 color;
     Vector4 normal;
+
+    // Index of the model vertex this vertex comes from, SIZE_MAX for vertexes created by clipping and for vertexes of
+    // instances placed by a scene, which are lit every frame so that the cache does not grow with the instance count.
+    // Lets later stages cache per vertex results between frames, so it must be unique within a vertex array.
+    size_t index = SIZE_MAX;
 };
 
 #endif